@@ -0,0 +1,265 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "TPCECalSelection.hxx"
+#include "TMath.h"
+#include "TVector3.h"
+
+/**
+   Checks that ECalAcceptanceKernel, which compares squared cosines, classifies
+   back TPC segments as the TVector3 angle and azimuth code that it replaced.
+
+   The segments are a grid of end positions and directions, which includes the
+   edges of the DS and barrel faces, directions exactly at the angular limits,
+   the zero vector, NaN coordinates and directions with no x component. Each
+   disagreement is listed.
+
+   Usage: CheckTPCECalAcceptance
+*/
+
+/// The end position and direction of a back TPC segment
+struct SegmentEnd
+{
+   Float_t Position[3];
+   Float_t Direction[3];
+};
+
+/**
+   Tests whether a segment points into the DS ECal, as DSECalTracksCut did
+   before the kernel.
+
+   \param end  The segment end.
+   \return  True if it does, False otherwise.
+*/
+static bool InDownstreamBaseline(const SegmentEnd& end)
+{
+   TVector3 pos(end.Position[0], end.Position[1], end.Position[2]);
+   if(std::isnan(pos.X()) || !(
+      (pos.X() >= DS::TpcXMin && pos.X() <= DS::TpcXMax) &&
+      (pos.Y() >= DS::TpcYMin && pos.Y() <= DS::TpcYMax) &&
+      (pos.Z() >= DS::TpcZMin)))
+   {
+      return false;
+   }
+
+   TVector3 dir(end.Direction[0], end.Direction[1], end.Direction[2]);
+   TVector3 zdir(0.0, 0.0, 1.0);
+   double tpcBackAngleFromZ = TMath::RadToDeg() * dir.Unit().Angle(zdir);
+   if(std::isnan(dir.X()) || !(tpcBackAngleFromZ <= DS::TpcAngleMax))
+   {
+      return false;
+   }
+
+   return true;
+}
+
+/**
+   Tests whether a segment points into the barrel ECal, as BarrelTracksCut did
+   before the kernel.
+
+   \param end  The segment end.
+   \return  True if it does, False otherwise.
+*/
+static bool InBarrelBaseline(const SegmentEnd& end)
+{
+   TVector3 pos(end.Position[0], end.Position[1], end.Position[2]);
+   if(std::isnan(pos.X()) || !(
+      ((pos.X() < Barrel::TpcXMin) || (pos.X() > Barrel::TpcXMax) ||
+      (pos.Y() < Barrel::TpcYMin) || (pos.Y() > Barrel::TpcYMax)) &&
+      (pos.Z() >= Barrel::TpcZMin && pos.Z() <= Barrel::TpcZMax)))
+   {
+      return false;
+   }
+
+   TVector3 dir(end.Direction[0], end.Direction[1], end.Direction[2]);
+   TVector3 zdir(0.0, 0.0, 1.0);
+   double tpcBackAzimuth = TMath::RadToDeg() * TMath::ATan(dir.X() / dir.Y());
+
+   if(dir.X() > 0 && dir.Y() < 0)
+   {
+      tpcBackAzimuth += 180;
+   }
+   else if(dir.X() < 0 && dir.Y() < 0)
+   {
+      tpcBackAzimuth -= 180;
+   }
+
+   double tpcBackAngleFromZ = dir.Unit().Dot(zdir);
+   tpcBackAngleFromZ = TMath::RadToDeg() * TMath::ACos(tpcBackAngleFromZ);
+
+   if(std::isnan(dir.X()) || !(
+      (tpcBackAngleFromZ >= Barrel::TpcAngleMin) &&
+      (fabs(tpcBackAzimuth) <= Barrel::TpcAzimuthAbs)))
+   {
+      return false;
+   }
+
+   return true;
+}
+
+/**
+   Adds a segment end for every pair of the given positions and directions.
+
+   \param positions  The end positions, three coordinates each.
+   \param directions The end directions, three components each.
+   \param ends The list to add to.
+*/
+static void AddGrid(const std::vector<Float_t>& positions,
+   const std::vector<Float_t>& directions, std::vector<SegmentEnd>& ends)
+{
+   for(unsigned int p = 0; p < positions.size(); p += 3)
+   {
+      for(unsigned int d = 0; d < directions.size(); d += 3)
+      {
+         SegmentEnd end;
+         for(int j = 0; j < 3; ++j)
+         {
+            end.Position[j] = positions[p + j];
+            end.Direction[j] = directions[d + j];
+         }
+         ends.push_back(end);
+      }
+   }
+}
+
+/**
+   Adds the direction at the given angle from z and azimuth from y.
+
+   \param angle   The angle from z, in degrees.
+   \param azimuth The azimuth from y, in degrees.
+   \param length  The length of the direction.
+   \param directions The list to add to.
+*/
+static void AddDirection(const double angle, const double azimuth,
+   const double length, std::vector<Float_t>& directions)
+{
+   const double theta = angle * TMath::DegToRad();
+   const double phi = azimuth * TMath::DegToRad();
+   directions.push_back(length * std::sin(theta) * std::sin(phi));
+   directions.push_back(length * std::sin(theta) * std::cos(phi));
+   directions.push_back(length * std::cos(theta));
+}
+
+int main()
+{
+   const Float_t nan = std::numeric_limits<Float_t>::quiet_NaN();
+
+   // Inside, on the edges of and just outside each face, and NaN coordinates.
+   // A barrel position with a NaN y is still outside the TPC in x.
+   const Float_t positionList[] = {
+      0, 0, 2700,
+      DS::TpcXMin, DS::TpcYMin, DS::TpcZMin,
+      DS::TpcXMax, DS::TpcYMax, DS::TpcZMin,
+      DS::TpcXMax + 1, 0, 2700,
+      0, DS::TpcYMax + 1, 2700,
+      0, 0, DS::TpcZMin - 1,
+      Barrel::TpcXMax + 1, 0, 1500,
+      Barrel::TpcXMin - 1, 0, 1500,
+      0, Barrel::TpcYMax + 1, 1500,
+      0, Barrel::TpcYMin - 1, 1500,
+      Barrel::TpcXMax + 1, 0, Barrel::TpcZMin,
+      Barrel::TpcXMax + 1, 0, Barrel::TpcZMax,
+      Barrel::TpcXMax + 1, 0, Barrel::TpcZMax + 1,
+      Barrel::TpcXMax, Barrel::TpcYMax, 1500,
+      0, 0, 1500,
+      nan, 0, 2700,
+      0, nan, 2700,
+      0, 0, nan,
+      Barrel::TpcXMax + 1, nan, 1500,
+      nan, Barrel::TpcYMax + 1, 1500};
+   std::vector<Float_t> positions(positionList,
+      positionList + sizeof(positionList) / sizeof(positionList[0]));
+
+   // A grid of unit and longer directions
+   std::vector<Float_t> directions;
+   for(double angle = 0; angle <= 180; angle += 2.5)
+   {
+      for(double azimuth = -180; azimuth < 180; azimuth += 5)
+      {
+         AddDirection(angle, azimuth, 1, directions);
+         AddDirection(angle, azimuth, 3.7, directions);
+      }
+   }
+
+   // Exactly at the limits
+   for(double azimuth = -180; azimuth < 180; azimuth += 30)
+   {
+      AddDirection(DS::TpcAngleMax, azimuth, 1, directions);
+      AddDirection(Barrel::TpcAngleMin, azimuth, 1, directions);
+   }
+   for(double angle = 0; angle <= 180; angle += 15)
+   {
+      AddDirection(angle, Barrel::TpcAzimuthAbs, 1, directions);
+      AddDirection(angle, -Barrel::TpcAzimuthAbs, 1, directions);
+   }
+
+   // The zero vector, NaN components and no x or no y component
+   const Float_t directionList[] = {
+      0, 0, 0,
+      nan, 0, 1,
+      0, nan, 1,
+      0, 0, nan,
+      nan, nan, nan,
+      0, 1, 0,
+      0, -1, 0,
+      0, 0, 1,
+      0, 0, -1,
+      0, -1, 0.5,
+      0, 1, -0.5,
+      1, 0, 0,
+      -1, 0, 0,
+      1, 0, 0.5};
+   directions.insert(directions.end(), directionList,
+      directionList + sizeof(directionList) / sizeof(directionList[0]));
+
+   std::vector<SegmentEnd> ends;
+   AddGrid(positions, directions, ends);
+
+   // Fill the columns the kernel reads directly
+   TPCBackSegmentCache segments;
+   std::vector<int> rows(ends.size());
+   for(int j = 0; j < 3; ++j)
+   {
+      segments.PositionEnd[j].resize(ends.size());
+      segments.DirectionEnd[j].resize(ends.size());
+   }
+   for(unsigned int i = 0; i < ends.size(); ++i)
+   {
+      rows[i] = i;
+      for(int j = 0; j < 3; ++j)
+      {
+         segments.PositionEnd[j][i] = ends[i].Position[j];
+         segments.DirectionEnd[j][i] = ends[i].Direction[j];
+      }
+   }
+
+   std::vector<unsigned char> regions(ends.size());
+   ECalAcceptanceKernel kernel;
+   kernel.Classify(segments, rows.data(), rows.size(), regions.data());
+
+   unsigned int nDisagree = 0;
+   for(unsigned int i = 0; i < ends.size(); ++i)
+   {
+      const bool downstream = regions[i] & ECalAcceptanceKernel::kDownstream;
+      const bool barrel = regions[i] & ECalAcceptanceKernel::kBarrel;
+      const bool downstreamBaseline = InDownstreamBaseline(ends[i]);
+      const bool barrelBaseline = InBarrelBaseline(ends[i]);
+      if(downstream != downstreamBaseline || barrel != barrelBaseline)
+      {
+         ++nDisagree;
+         std::cout << "Position (" << ends[i].Position[0] << ", " <<
+            ends[i].Position[1] << ", " << ends[i].Position[2] <<
+            "), direction (" << ends[i].Direction[0] << ", " <<
+            ends[i].Direction[1] << ", " << ends[i].Direction[2] << "): " <<
+            "kernel DS " << downstream << " barrel " << barrel <<
+            ", TVector3 DS " << downstreamBaseline << " barrel " <<
+            barrelBaseline << std::endl;
+      }
+   }
+
+   std::cout << nDisagree << " of " << ends.size() << " segments classified "
+      "differently" << std::endl;
+
+   return nDisagree ? 1 : 0;
+}
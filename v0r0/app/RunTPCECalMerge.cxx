@@ -0,0 +1,42 @@
+#include <iostream>
+#include "MicroTreeMerger.hxx"
+#include "StepProfiler.hxx"
+
+/**
+   Merges the outputs of the shards of an input list, run separately with the
+   --shard option of RunTPCECalSystematicsAnalysis, e.g. on batch nodes. The
+   shards must be given in order for the merged micro-trees to be in event
+   order. The POT of the merged file, and the step profile if the shards were
+   profiled, is the sum over the shards.
+
+   Usage: RunTPCECalMerge <output file> <shard output files...>
+*/
+int main(int argc, char *argv[])
+{
+   if(argc < 3)
+   {
+      std::cerr << "Usage: " << argv[0] << " <output file> " <<
+         "<shard output files...>" << std::endl;
+      return 1;
+   }
+
+   MicroTreeMerger merger(argv[1]);
+   for(int i = 2; i < argc; ++i)
+   {
+      merger.AddFile(argv[i]);
+   }
+
+   if(!merger.Merge())
+   {
+      return 1;
+   }
+
+   StepProfiler& profiler = StepProfiler::Get();
+   if(profiler.Read(argv[1]))
+   {
+      profiler.Print();
+      profiler.Write(argv[1]);
+   }
+
+   return 0;
+}
@@ -3,6 +3,18 @@
 #include "Detector.hxx"
 #include "Particle.hxx"
 #include "AnalysisVariable.hxx"
+#include "EfficiencyEngine.hxx"
+#include "EfficiencyCache.hxx"
+#include "DataSampleRegistry.hxx"
+#include "TLeaf.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using TPCECalSystematics::Bins;
 using TPCECalSystematics::Detector;
@@ -12,6 +24,46 @@ using TPCECalSystematics::AnalysisVariable;
 typedef std::vector<std::string> vecstr;
 typedef std::vector<Bins> BinsVector;
 
+/// The range of the single bin of the unbinned summaries
+double UNBINNED[2] = {0, 100000};
+
+// Compiled forms of the detector signals and cuts and analysis variables,
+// which must agree with their strings in main
+bool IsEnteringBarrel(const MicroTreeView& view)
+{
+   return view.GetEntersBarrel() == 1;
+}
+
+bool IsEnteringDownstream(const MicroTreeView& view)
+{
+   return view.GetEntersDownstream() == 1;
+}
+
+bool IsInBarrelECal(const MicroTreeView& view)
+{
+   return view.GetEcalDetector() == 23;
+}
+
+bool IsInDownstreamECal(const MicroTreeView& view)
+{
+   return view.GetEcalDetector() == 6;
+}
+
+double GetTrackMomentum(const MicroTreeView& view)
+{
+   return view.GetMomentum();
+}
+
+double GetTrackCosTheta(const MicroTreeView& view)
+{
+   return view.GetCosTheta();
+}
+
+/// Part of the key of every cached efficiency. Change it whenever the
+/// compiled forms above change, so that efficiencies filled by the old ones
+/// are not found again.
+const char* const EFFICIENCYCACHESALT = "1";
+
 const vecstr GetEnvironmentVariables(bool mcp)
 {
    vecstr envVars;
@@ -122,21 +174,86 @@ void GetFilenames(vecstr& rdpFiles, vecstr& mcpFiles)
    }
 }
 
-DataSample GetDataSample(std::string filename)
+/**
+   Points the sel* aliases used for plotting at the variables of a selection.
+   Microtrees from a single-selection run hold scalar variables, whereas those
+   from a RunAllSelections run hold one entry per selection.
+
+   \param data The data sample to be plotted.
+   \param selection   The index of the selection.
+   \param particle The particle that the selection selects.
+   \return  The name of the selection's particle category.
+*/
+std::string UseSelection(DataSample& data, const int selection,
+   const Particle& particle)
 {
-   DataSample data(filename.c_str());
-   if(data.GetTree()->GetEntries() == 0)
+   TTree* tree = data.GetTree();
+   TLeaf* leaf = tree->GetLeaf("entersBarrel");
+   bool allSelections = leaf && leaf->GetLen() > 1;
+
+   std::ostringstream index;
+   if(allSelections)
+   {
+      index << "[" << selection << "]";
+   }
+
+   tree->SetAlias("selEntersBarrel", ("entersBarrel" + index.str()).c_str());
+   tree->SetAlias("selEntersDownstream",
+      ("entersDownstream" + index.str()).c_str());
+   tree->SetAlias("selEcalDetector", ("ecalDetector" + index.str()).c_str());
+   tree->SetAlias("selMomentum", ("momentum" + index.str()).c_str());
+   tree->SetAlias("selCosTheta", ("direction" + index.str() + "[2]").c_str());
+
+   return allSelections ? particle.GetName() + "_particle" : "particle";
+}
+
+/**
+   Gets the data sample of a file from the registry, which opens it once for
+   every loop of the job.
+
+   \param samples The registry.
+   \param filename   The file.
+   \return  The data sample.
+*/
+DataSample& GetDataSample(DataSampleRegistry& samples,
+   const std::string& filename)
+{
+   DataSample* data = samples.Get(filename);
+   if(!data)
    {
       std::cerr << "Error: Tree " << filename << " has no entries. Exiting." <<
          std::endl;
       exit(1);
    }
-   return data;
+   return *data;
+}
+
+/**
+   Requests an efficiency of an engine, unless it is already cached.
+
+   \param cache   The cache, or NULL for none.
+   \param engine  The engine.
+   \param data The data sample of the engine.
+   \param variable   The binning variable.
+   \param detector   The detector, giving the signal and cut.
+   \param bins   The bins.
+*/
+void AddEfficiency(EfficiencyCache* cache, EfficiencyEngine& engine,
+   DataSample& data, const AnalysisVariable& variable,
+   const Detector& detector, Bins& bins)
+{
+   if(!cache || !cache->Contains(data, variable.GetMicrotreeVariable(),
+      detector.GetSignal(), detector.GetCut(), bins.GetNumBins(),
+      bins.GetBoundaries()))
+   {
+      engine.Add(variable, detector, bins.GetNumBins(), bins.GetBoundaries());
+   }
 }
 
 void DrawSelection(DrawingToolsTPCECal& draw, TCanvas* c1,
    DataSample& rdp, DataSample& mcp, const AnalysisVariable& variable, Bins& bins,
-   const Detector& detector, const Particle& particle)
+   const Detector& detector, const Particle& particle,
+   const std::string& category)
 {
    draw.SetLegendSize(0.12, 0.35);
    draw.SetLegendPos("tr");
@@ -147,7 +264,7 @@ void DrawSelection(DrawingToolsTPCECal& draw, TCanvas* c1,
    int n = bins.GetNumBins();
    double* boundaries = bins.GetBoundaries();
    draw.Draw(rdp, mcp, variable.GetMicrotreeVariable(), n, boundaries,
-      "particle", detector.GetSignal());
+      category, detector.GetSignal());
    ss << "sel_" << variable.GetName() << "_" << detector.GetName() << "_" <<
       particle.GetName() << ".png";
    c1->Print(ss.str().c_str(), "png");
@@ -234,7 +351,8 @@ void DrawCombinedSystematics(DrawingToolsTPCECal& draw, TCanvas* c1,
 }
 
 void DrawPurity(DrawingToolsTPCECal& draw, TCanvas* c1, DataSample& mcp,
-   const Detector& detector, const Particle& particle, const int selection)
+   const Detector& detector, const Particle& particle, const int selection,
+   const std::string& category)
 {
    draw.SetLegendSize(0.12, 0.1);
    draw.SetLegendPos("tr");
@@ -242,7 +360,7 @@ void DrawPurity(DrawingToolsTPCECal& draw, TCanvas* c1, DataSample& mcp,
    draw.SetTitleY("Purity/Efficiency");
    std::ostringstream ss;
 
-   ss << "particle==" << particle.GetPDG();
+   ss << category << "==" << particle.GetPDG();
    draw.DrawEffPurVSCut(mcp, selection, (detector.GetName() == "ds") ? 0 : 1,
       ss.str(), "");
    ss.str(""); ss.clear();
@@ -254,17 +372,16 @@ void PrintSummaryDataUnbinned(DrawingToolsTPCECal& draw, DataSample& rdp,
    DataSample& mcp, const AnalysisVariable& variable, const Detector& detector,
    const Particle& particle)
 {
-   double bins[2] = {0, 100000};
    std::vector<double> errors(1);
 
    std::cout.setf(ios::fixed,ios::floatfield);
    std::cout.precision(3);
 
    double rdpEff = draw.GetEfficiency(rdp, variable.GetMicrotreeVariable(),
-      detector.GetSignal(), detector.GetCut(), 1, bins, &errors).at(0);
+      detector.GetSignal(), detector.GetCut(), 1, UNBINNED, &errors).at(0);
    double rdpErr = errors.at(0);
    double mcpEff = draw.GetEfficiency(mcp, variable.GetMicrotreeVariable(),
-      detector.GetSignal(), detector.GetCut(), 1, bins, &errors).at(0);
+      detector.GetSignal(), detector.GetCut(), 1, UNBINNED, &errors).at(0);
    double mcpErr = errors.at(0);
    std::cout << particle.GetName() << " : " << detector.GetDescription() <<
       std::endl;
@@ -314,17 +431,16 @@ void PrintLaTeXSummaryDataUnbinned(DrawingToolsTPCECal& draw, DataSample& rdp,
    DataSample& mcp, const AnalysisVariable& variable, const Detector& detector,
    const Particle& particle)
 {
-   double bins[2] = {0, 100000};
    std::vector<double> errors(1);
 
    std::cout.setf(ios::fixed,ios::floatfield);
    std::cout.precision(3);
 
    double rdpEff = draw.GetEfficiency(rdp, variable.GetMicrotreeVariable(),
-      detector.GetSignal(), detector.GetCut(), 1, bins, &errors).at(0);
+      detector.GetSignal(), detector.GetCut(), 1, UNBINNED, &errors).at(0);
    double rdpErr = errors.at(0);
    double mcpEff = draw.GetEfficiency(mcp, variable.GetMicrotreeVariable(),
-      detector.GetSignal(), detector.GetCut(), 1, bins, &errors).at(0);
+      detector.GetSignal(), detector.GetCut(), 1, UNBINNED, &errors).at(0);
    double mcpErr = errors.at(0);
    double systematic = 100 * GetSystematicUncertainty(rdpEff, mcpEff);
    double error = 100 * GetSystematicError(rdpErr, mcpErr);
@@ -363,202 +479,705 @@ void PrintLaTeXSummaryDataBinned(DrawingToolsTPCECal& draw, DataSample& rdp,
    }
 }
 
-int main(int argc, char *argv[])
+/**
+   The plots and summaries of every species. These are made in sections, each
+   of which is run for one species, or one nu/nubar mode pair, so that they
+   can be shared out between worker processes.
+*/
+class PlotJob
+{
+public:
+   /// The sections, in the order in which a serial job runs them
+   enum Section
+   {
+      kSpecies = 0,
+      kCombined,
+      kUnbinned,
+      kBinned,
+      kLaTeX,
+      kPurity,
+      kNSections
+   };
+
+   PlotJob();
+   virtual ~PlotJob();
+
+   /**
+      Gets the number of times a section is run: once per species, or once
+      per nu/nubar mode pair.
+
+      \param section The section.
+      \return  The number of times.
+   */
+   unsigned int GetNumIndices(const Section section) const;
+
+   /**
+      Limits the job to the sections of one species, or to the combined
+      section of one nu/nubar mode pair, named by the species followed by
+      "like" (e.g. elike).
+
+      \param name   The name of the species or pair, or empty for every one.
+      \return  True if the name is known, False otherwise.
+   */
+   bool Select(const std::string& name);
+
+   /**
+      Checks whether the job runs a section for one species or nu/nubar mode
+      pair.
+
+      \param section The section.
+      \param i The index of the species or pair.
+      \return  True if it is run, False otherwise.
+   */
+   bool IsSelected(const Section section, const unsigned int i) const;
+
+   /**
+      Hands the drawing tools of a section the engine of a species' sample.
+      The engine has every efficiency of the sample that any section plots
+      or prints and that is not cached. It is filled, in one pass over the
+      sample, the first time a section asks for it, and then kept for the
+      other sections.
+
+      \param draw The drawing tools.
+      \param data The data sample, with the aliases of its selection set.
+      \param selection   The index of the selection.
+   */
+   void UseEfficiencyEngine(DrawingToolsTPCECal& draw, DataSample& data,
+      const unsigned int selection);
+
+   /**
+      Runs a section for one species or nu/nubar mode pair.
+
+      \param section The section.
+      \param i The index of the species or pair.
+      \param c1   The canvas to draw on.
+   */
+   void Run(const Section section, const unsigned int i, TCanvas* c1);
+
+private:
+   PlotJob(const PlotJob&);
+   PlotJob& operator=(const PlotJob&);
+
+   void DrawSpecies(TCanvas* c1, const unsigned int i);
+   void DrawCombined(TCanvas* c1, const unsigned int i);
+   void PrintUnbinnedSummary(const unsigned int i);
+   void PrintBinnedSummary(const unsigned int i);
+   void PrintLaTeXSummary(const unsigned int i);
+   void DrawPurities(TCanvas* c1, const unsigned int i);
+   EfficiencyEngine* CreateEfficiencyEngine(DataSample& data,
+      const unsigned int selection);
+
+   vecstr _rdpFiles;
+   vecstr _mcpFiles;
+   BinsVector _dsMomBins;
+   BinsVector _brMomBins;
+   BinsVector _dsAngBins;
+   BinsVector _brAngBins;
+   Detector _barrel;
+   Detector _downstream;
+   AnalysisVariable _momentum;
+   AnalysisVariable _angle;
+   std::vector<const Particle*> _particle;
+   std::string _selected;
+   DataSampleRegistry* _samples;
+   EfficiencyCache* _efficiencyCache;
+   /// The engine of each sample and selection, or NULL where every
+   /// efficiency is cached
+   std::map<std::pair<DataSample*, unsigned int>, EfficiencyEngine*> _engines;
+};
+
+// Detector signal and cut details. These use the aliases set by UseSelection,
+// so work for both single and all selection microtrees.
+PlotJob::PlotJob():
+   _barrel("br", "Barrel", "selEntersBarrel==1", "selEcalDetector==23",
+      IsEnteringBarrel, IsInBarrelECal),
+   _downstream("ds", "Downstream", "selEntersDownstream==1",
+      "selEcalDetector==6", IsEnteringDownstream, IsInDownstreamECal),
+   _momentum("selMomentum", "mom", "Track Momentum (MeV)", GetTrackMomentum),
+   _angle("selCosTheta", "ang", "cos(Track Angle)", GetTrackCosTheta)
+{
+   GetFilenames(_rdpFiles, _mcpFiles);
+   CreateBins(_dsMomBins, _brMomBins, _dsAngBins, _brAngBins);
+
+   _particle.push_back(new Particle("e", 11));
+   _particle.push_back(new Particle("mu", 13));
+   _particle.push_back(new Particle("p", 2212));
+   _particle.push_back(new Particle("ebar", -11));
+   _particle.push_back(new Particle("mubar", -13));
+
+   // Every section reads the ECal variables, and the purities the cut levels
+   // and categories, so these are read into memory once, the first time each
+   // file is read
+   vecstr warmBranches;
+   warmBranches.push_back("entersBarrel");
+   warmBranches.push_back("entersDownstream");
+   warmBranches.push_back("ecalDetector");
+   warmBranches.push_back("momentum");
+   warmBranches.push_back("direction");
+   warmBranches.push_back("accum_level");
+   warmBranches.push_back("particle");
+   for(unsigned int i = 0; i < _particle.size(); ++i)
+   {
+      warmBranches.push_back(_particle[i]->GetName() + "_particle");
+   }
+   _samples = new DataSampleRegistry(warmBranches);
+
+   // Efficiencies are kept between runs if EFFICIENCY_CACHE_FILE is set
+   const char* cacheFile = getenv("EFFICIENCY_CACHE_FILE");
+   _efficiencyCache = cacheFile && *cacheFile ?
+      new EfficiencyCache(cacheFile, EFFICIENCYCACHESALT) : nullptr;
+}
+
+PlotJob::~PlotJob()
 {
-   vecstr rdpFiles;
-   vecstr mcpFiles;
-   GetFilenames(rdpFiles, mcpFiles);
+   for(std::map<std::pair<DataSample*, unsigned int>,
+      EfficiencyEngine*>::iterator it = _engines.begin(); it != _engines.end();
+      ++it)
+   {
+      delete it->second;
+   }
+   delete _efficiencyCache;
+   delete _samples;
+   for(unsigned int i = 0; i < _particle.size(); ++i)
+   {
+      delete _particle[i];
+   }
+}
 
-   gStyle->SetOptStat(0);
+unsigned int PlotJob::GetNumIndices(const Section section) const
+{
+   return section == kCombined ? 2 : _rdpFiles.size();
+}
+
+bool PlotJob::Select(const std::string& name)
+{
+   _selected = name;
+   for(unsigned int i = 0; i < _particle.size(); ++i)
+   {
+      if(IsSelected(kSpecies, i) ||
+         (i < GetNumIndices(kCombined) && IsSelected(kCombined, i)))
+      {
+         return true;
+      }
+   }
+   _selected = "";
+
+   return false;
+}
+
+bool PlotJob::IsSelected(const Section section, const unsigned int i) const
+{
+   if(_selected.empty())
+   {
+      return true;
+   }
+   if(section == kCombined)
+   {
+      return _selected == _particle[i]->GetName() + "like";
+   }
+   return _selected == _particle[i]->GetName();
+}
+
+void PlotJob::UseEfficiencyEngine(DrawingToolsTPCECal& draw,
+   DataSample& data, const unsigned int selection)
+{
+   draw.SetEfficiencyCache(_efficiencyCache);
+
+   const std::pair<DataSample*, unsigned int> key(&data, selection);
+   std::map<std::pair<DataSample*, unsigned int>,
+      EfficiencyEngine*>::iterator it = _engines.find(key);
+   if(it == _engines.end())
+   {
+      it = _engines.insert(std::make_pair(key,
+         CreateEfficiencyEngine(data, selection))).first;
+   }
+   if(it->second)
+   {
+      draw.AddEfficiencyEngine(it->second);
+   }
+}
+
+/**
+   Creates the engine of a species' sample and fills it with every
+   efficiency of the species, and of the nu/nubar mode pair it is in, that
+   is plotted or printed and not cached.
+
+   \param data The data sample, with the aliases of its selection set.
+   \param selection   The index of the selection.
+   \return  The engine, or NULL if every efficiency is cached.
+*/
+EfficiencyEngine* PlotJob::CreateEfficiencyEngine(DataSample& data,
+   const unsigned int selection)
+{
+   // The combined section bins a nubar species as its nu partner
+   const unsigned int pair = selection >= 3 ? selection - 3 : selection;
+   const unsigned int binned[2] = {selection, pair};
+
+   EfficiencyEngine* engine = new EfficiencyEngine(data, selection);
+   Bins unbinned(UNBINNED, 1);
+   for(unsigned int b = 0; b < 2; ++b)
+   {
+      const unsigned int i = binned[b];
+      AddEfficiency(_efficiencyCache, *engine, data, _momentum, _downstream,
+         _dsMomBins[i]);
+      AddEfficiency(_efficiencyCache, *engine, data, _angle, _downstream,
+         _dsAngBins[i]);
+      AddEfficiency(_efficiencyCache, *engine, data, _momentum, _barrel,
+         _brMomBins[i]);
+      AddEfficiency(_efficiencyCache, *engine, data, _angle, _barrel,
+         _brAngBins[i]);
+   }
+   AddEfficiency(_efficiencyCache, *engine, data, _momentum, _downstream,
+      unbinned);
+   AddEfficiency(_efficiencyCache, *engine, data, _momentum, _barrel,
+      unbinned);
 
-   BinsVector dsMomBins;
-   BinsVector brMomBins;
-   BinsVector dsAngBins;
-   BinsVector brAngBins;
-   CreateBins(dsMomBins, brMomBins, dsAngBins, brAngBins);
+   // The tree is not read at all if every efficiency is cached
+   if(engine->GetNumRequests() == 0)
+   {
+      delete engine;
+      return nullptr;
+   }
+   _samples->Warm(data);
+   engine->Fill();
 
-   // Detector signal and cut details
-   Detector barrel("br", "Barrel", "entersBarrel==1", "ecalDetector==23");
-   Detector downstream("ds", "Downstream", "entersDownstream==1", "ecalDetector==6");
+   return engine;
+}
 
-   // Analysis variables
-   AnalysisVariable momentum("momentum", "mom", "Track Momentum (MeV)");
-   AnalysisVariable angle("direction[2]", "ang", "cos(Track Angle)");
+void PlotJob::Run(const Section section, const unsigned int i, TCanvas* c1)
+{
+   switch(section)
+   {
+      case kSpecies:
+         DrawSpecies(c1, i);
+         break;
+      case kCombined:
+         DrawCombined(c1, i);
+         break;
+      case kUnbinned:
+         PrintUnbinnedSummary(i);
+         break;
+      case kBinned:
+         PrintBinnedSummary(i);
+         break;
+      case kLaTeX:
+         PrintLaTeXSummary(i);
+         break;
+      case kPurity:
+         DrawPurities(c1, i);
+         break;
+      default:
+         break;
+   }
+}
 
+void PlotJob::DrawSpecies(TCanvas* c1, const unsigned int i)
+{
+   DataSample& rdp = GetDataSample(*_samples, _rdpFiles[i]);
+   DataSample& mcp = GetDataSample(*_samples, _mcpFiles[i]);
+   UseSelection(rdp, i, *(_particle[i]));
+   std::string category = UseSelection(mcp, i, *(_particle[i]));
+
+   DrawingToolsTPCECal draw(_mcpFiles[i]);
+   UseEfficiencyEngine(draw, rdp, i);
+   UseEfficiencyEngine(draw, mcp, i);
+
+   // The selections are drawn from the trees, cached or not
+   _samples->Warm(rdp);
+   _samples->Warm(mcp);
+
+   draw.SetDifferentStackFillStyles();
+   draw.ApplyRange(false);
+   draw.DumpPOT(rdp);
+   draw.DumpPOT(mcp);
+
+   // Momentum selections
+   DrawSelection(draw, c1, rdp, mcp, _momentum, _dsMomBins[i], _downstream,
+      *(_particle[i]), category);
+   DrawSelection(draw, c1, rdp, mcp, _momentum, _brMomBins[i], _barrel,
+      *(_particle[i]), category);
+
+   // Track angle selections
+   DrawSelection(draw, c1, rdp, mcp, _angle, _dsAngBins[i], _downstream,
+      *(_particle[i]), category);
+   DrawSelection(draw, c1, rdp, mcp, _angle, _brAngBins[i], _barrel,
+      *(_particle[i]), category);
+
+   // Momentum effiencies
+   DrawEfficiencies(draw, c1, rdp, mcp, _momentum, _dsMomBins[i], _downstream,
+      *(_particle[i]));
+   DrawEfficiencies(draw, c1, rdp, mcp, _momentum, _brMomBins[i], _barrel,
+      *(_particle[i]));
+
+   // Track angle effiencies
+   DrawEfficiencies(draw, c1, rdp, mcp, _angle, _dsAngBins[i], _downstream,
+      *(_particle[i]));
+   DrawEfficiencies(draw, c1, rdp, mcp, _angle, _brAngBins[i], _barrel,
+      *(_particle[i]));
+
+   // Momentum systematics
+   DrawSystematics(draw, c1, rdp, mcp, _momentum, _dsMomBins[i], _downstream,
+      *(_particle[i]));
+   DrawSystematics(draw, c1, rdp, mcp, _momentum, _brMomBins[i], _barrel,
+      *(_particle[i]));
+
+   // Track angle systematics
+   DrawSystematics(draw, c1, rdp, mcp, _angle, _dsAngBins[i], _downstream,
+      *(_particle[i]));
+   DrawSystematics(draw, c1, rdp, mcp, _angle, _brAngBins[i], _barrel,
+      *(_particle[i]));
+}
+
+void PlotJob::DrawCombined(TCanvas* c1, const unsigned int i)
+{
+   DataSample& nuRdp = GetDataSample(*_samples, _rdpFiles[i]);
+   DataSample& nubarRdp = GetDataSample(*_samples, _rdpFiles[i + 3]);
+   DataSample& nuMcp = GetDataSample(*_samples, _mcpFiles[i]);
+   DataSample& nubarMcp = GetDataSample(*_samples, _mcpFiles[i + 3]);
+   UseSelection(nuRdp, i, *(_particle[i]));
+   UseSelection(nubarRdp, i + 3, *(_particle[i + 3]));
+   UseSelection(nuMcp, i, *(_particle[i]));
+   UseSelection(nubarMcp, i + 3, *(_particle[i + 3]));
+
+   DrawingToolsTPCECal draw(_mcpFiles[i]);
+   UseEfficiencyEngine(draw, nuRdp, i);
+   UseEfficiencyEngine(draw, nubarRdp, i + 3);
+   UseEfficiencyEngine(draw, nuMcp, i);
+   UseEfficiencyEngine(draw, nubarMcp, i + 3);
+
+   draw.SetDifferentStackFillStyles();
+   draw.ApplyRange(false);
+
+   // Momentum effiencies
+   DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _momentum, _dsMomBins[i], _downstream, *(_particle[i]));
+   DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _momentum, _brMomBins[i], _barrel, *(_particle[i]));
+
+   // Track angle effiencies
+   DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _angle, _dsAngBins[i], _downstream, *(_particle[i]));
+   DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _angle, _brAngBins[i], _barrel, *(_particle[i]));
+
+   // Momentum systematics
+   DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _momentum, _dsMomBins[i], _downstream, *(_particle[i]));
+   DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _momentum, _brMomBins[i], _barrel, *(_particle[i]));
+
+   // Track angle systematics
+   DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _angle, _dsAngBins[i], _downstream, *(_particle[i]));
+   DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
+      _angle, _brAngBins[i], _barrel, *(_particle[i]));
+}
+
+void PlotJob::PrintUnbinnedSummary(const unsigned int i)
+{
+   DataSample& rdp = GetDataSample(*_samples, _rdpFiles[i]);
+   DataSample& mcp = GetDataSample(*_samples, _mcpFiles[i]);
+   UseSelection(rdp, i, *(_particle[i]));
+   UseSelection(mcp, i, *(_particle[i]));
+
+   DrawingToolsTPCECal draw(_mcpFiles[i]);
+   UseEfficiencyEngine(draw, rdp, i);
+   UseEfficiencyEngine(draw, mcp, i);
+
+   PrintSummaryDataUnbinned(draw, rdp, mcp, _momentum, _downstream,
+      *(_particle[i]));
+   PrintSummaryDataUnbinned(draw, rdp, mcp, _momentum, _barrel,
+      *(_particle[i]));
+}
+
+void PlotJob::PrintBinnedSummary(const unsigned int i)
+{
+   DataSample& rdp = GetDataSample(*_samples, _rdpFiles[i]);
+   DataSample& mcp = GetDataSample(*_samples, _mcpFiles[i]);
+   UseSelection(rdp, i, *(_particle[i]));
+   UseSelection(mcp, i, *(_particle[i]));
+
+   DrawingToolsTPCECal draw(_mcpFiles[i]);
+   UseEfficiencyEngine(draw, rdp, i);
+   UseEfficiencyEngine(draw, mcp, i);
+
+   PrintSummaryDataBinned(draw, rdp, mcp, _momentum, _dsMomBins[i],
+      _downstream, *(_particle[i]));
+   PrintSummaryDataBinned(draw, rdp, mcp, _momentum, _brMomBins[i],
+      _barrel, *(_particle[i]));
+   PrintSummaryDataBinned(draw, rdp, mcp, _angle, _dsAngBins[i],
+      _downstream, *(_particle[i]));
+   PrintSummaryDataBinned(draw, rdp, mcp, _angle, _brAngBins[i],
+      _barrel, *(_particle[i]));
+}
+
+void PlotJob::PrintLaTeXSummary(const unsigned int i)
+{
+   DataSample& rdp = GetDataSample(*_samples, _rdpFiles[i]);
+   DataSample& mcp = GetDataSample(*_samples, _mcpFiles[i]);
+   UseSelection(rdp, i, *(_particle[i]));
+   UseSelection(mcp, i, *(_particle[i]));
+
+   DrawingToolsTPCECal draw(_mcpFiles[i]);
+   UseEfficiencyEngine(draw, rdp, i);
+   UseEfficiencyEngine(draw, mcp, i);
+
+   PrintLaTeXSummaryDataUnbinned(draw, rdp, mcp, _momentum, _downstream,
+      *(_particle[i]));
+   PrintLaTeXSummaryDataUnbinned(draw, rdp, mcp, _momentum, _barrel,
+      *(_particle[i]));
+
+   PrintLaTeXSummaryDataBinned(draw, rdp, mcp, _momentum, _dsMomBins[i],
+      _downstream, *(_particle[i]));
+   PrintLaTeXSummaryDataBinned(draw, rdp, mcp, _momentum, _brMomBins[i],
+      _barrel, *(_particle[i]));
+   PrintLaTeXSummaryDataBinned(draw, rdp, mcp, _angle, _dsAngBins[i],
+      _downstream, *(_particle[i]));
+   PrintLaTeXSummaryDataBinned(draw, rdp, mcp, _angle, _brAngBins[i],
+      _barrel, *(_particle[i]));
+}
+
+void PlotJob::DrawPurities(TCanvas* c1, const unsigned int i)
+{
+   DataSample& mcp = GetDataSample(*_samples, _mcpFiles[i]);
+   std::string category = UseSelection(mcp, i, *(_particle[i]));
+   _samples->Warm(mcp);
+
+   DrawingToolsTPCECal draw(_mcpFiles[i]);
+
+   DrawPurity(draw, c1, mcp, _downstream, *(_particle[i]), i, category);
+   DrawPurity(draw, c1, mcp, _barrel, *(_particle[i]), i, category);
+}
+
+/**
+   Creates the canvas that the plots are drawn on.
+
+   \return  The canvas.
+*/
+TCanvas* CreateCanvas()
+{
    TCanvas* c1 = new TCanvas("c", "c");
 
    gPad->SetLeftMargin(0.12);
    gPad->SetBottomMargin(0.12);
    gPad->SetRightMargin(0.18);
-   
-   //vecstr particle;
-   std::vector<const Particle*> particle;
-   const Particle* e = new Particle("e", 11);
-   const Particle* mu = new Particle("mu", 13);
-   const Particle* p = new Particle("p", 2212);
-   const Particle* ebar = new Particle("ebar", -11);
-   const Particle* mubar = new Particle("mubar", -13);
-   particle.push_back(e);
-   particle.push_back(mu);
-   particle.push_back(p);
-   particle.push_back(ebar);
-   particle.push_back(mubar);
-   for(unsigned int i = 0; i < rdpFiles.size(); ++i)
+
+   return c1;
+}
+
+/**
+   Gets the file that holds the printed output of a section run in a worker.
+
+   \param directory  The directory of the files.
+   \param section The section.
+   \param i The index of the species or pair.
+   \return  The file.
+*/
+std::string GetSectionOutput(const std::string& directory, const int section,
+   const unsigned int i)
+{
+   std::ostringstream filename;
+   filename << directory << "/section" << section << "_" << i << ".txt";
+   return filename.str();
+}
+
+/**
+   Sends everything printed from now on, by either C or C++ streams, to a file.
+
+   \param filename   The file.
+   \return  True if the output was redirected, False otherwise.
+*/
+bool RedirectOutput(const std::string& filename)
+{
+   std::cout.flush();
+   fflush(stdout);
+   int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if(fd < 0)
    {
-      DataSample rdp = GetDataSample(rdpFiles[i]);
-      DataSample mcp = GetDataSample(mcpFiles[i]);
-
-      DrawingToolsTPCECal draw(mcpFiles[i]);
-
-      draw.SetDifferentStackFillStyles();
-      draw.ApplyRange(false);
-      draw.DumpPOT(rdp);
-      draw.DumpPOT(mcp);
-
-      // Momentum selections
-      DrawSelection(draw, c1, rdp, mcp, momentum, dsMomBins[i], downstream,
-         *(particle[i]));
-      DrawSelection(draw, c1, rdp, mcp, momentum, brMomBins[i], barrel,
-         *(particle[i]));
-
-      // Track angle selections
-      DrawSelection(draw, c1, rdp, mcp, angle, dsAngBins[i], downstream,
-         *(particle[i]));
-      DrawSelection(draw, c1, rdp, mcp, angle, brAngBins[i], barrel,
-         *(particle[i]));
-
-      // Momentum effiencies
-      DrawEfficiencies(draw, c1, rdp, mcp, momentum, dsMomBins[i], downstream,
-         *(particle[i]));
-      DrawEfficiencies(draw, c1, rdp, mcp, momentum, brMomBins[i], barrel,
-         *(particle[i]));
-
-      // Track angle effiencies
-      DrawEfficiencies(draw, c1, rdp, mcp, angle, dsAngBins[i], downstream,
-         *(particle[i]));
-      DrawEfficiencies(draw, c1, rdp, mcp, angle, brAngBins[i], barrel,
-         *(particle[i]));
-
-      // Momentum systematics
-      DrawSystematics(draw, c1, rdp, mcp, momentum, dsMomBins[i], downstream,
-         *(particle[i]));
-      DrawSystematics(draw, c1, rdp, mcp, momentum, brMomBins[i], barrel,
-         *(particle[i]));
-
-      // Track angle systematics
-      DrawSystematics(draw, c1, rdp, mcp, angle, dsAngBins[i], downstream,
-         *(particle[i]));
-      DrawSystematics(draw, c1, rdp, mcp, angle, brAngBins[i], barrel,
-         *(particle[i]));
+      return false;
    }
+   dup2(fd, STDOUT_FILENO);
+   close(fd);
+
+   return true;
+}
 
-   for(unsigned int i = 0; i < 2; ++i)
+/**
+   Runs the sections of each species, and of each nu/nubar mode pair, in
+   worker processes, each with its own canvas, drawing tools and data
+   samples. The plots are the same as those of a serial job, and the printed
+   output of the sections is collected and printed in the serial order.
+
+   \param job  The job.
+   \param nWorkers   The number of workers to run at once.
+   \return  The exit status.
+*/
+int RunWorkers(PlotJob& job, const int nWorkers)
+{
+   char directory[] = "/tmp/RunTPCECalPlot.XXXXXX";
+   if(!mkdtemp(directory))
    {
-      DataSample nuRdp = GetDataSample(rdpFiles[i]);
-      DataSample nubarRdp = GetDataSample(rdpFiles[i + 3]);
-      DataSample nuMcp = GetDataSample(mcpFiles[i]);
-      DataSample nubarMcp = GetDataSample(mcpFiles[i + 3]);
-
-      DrawingToolsTPCECal draw(mcpFiles[i]);
-
-      draw.SetDifferentStackFillStyles();
-      draw.ApplyRange(false);
-
-      // Momentum effiencies
-      DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         momentum, dsMomBins[i], downstream, *(particle[i]));
-      DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         momentum, brMomBins[i], barrel, *(particle[i]));
-
-      // Track angle effiencies
-      DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         angle, dsAngBins[i], downstream, *(particle[i]));
-      DrawCombinedEfficiencies(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         angle, brAngBins[i], barrel, *(particle[i]));
-
-      // Momentum systematics
-      DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         momentum, dsMomBins[i], downstream, *(particle[i]));
-      DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         momentum, brMomBins[i], barrel, *(particle[i]));
-
-      // Track angle systematics
-      DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         angle, dsAngBins[i], downstream, *(particle[i]));
-      DrawCombinedSystematics(draw, c1, nuRdp, nubarRdp, nuMcp, nubarMcp,
-         angle, brAngBins[i], barrel, *(particle[i]));
+      std::cerr << "Could not create a directory for the workers" << std::endl;
+      return 1;
    }
 
-   // Print unbinned summary
-   for(unsigned int i = 0; i < rdpFiles.size(); ++i)
+   // Each task is every section of a species, or the combined section of a
+   // pair. The species are the slowest, so are started first.
+   typedef std::vector<std::pair<PlotJob::Section, unsigned int> > Task;
+   std::vector<Task> tasks;
+   const PlotJob::Section speciesSections[5] = {PlotJob::kSpecies,
+      PlotJob::kUnbinned, PlotJob::kBinned, PlotJob::kLaTeX, PlotJob::kPurity};
+   for(unsigned int i = 0; i < job.GetNumIndices(PlotJob::kSpecies); ++i)
    {
-      DataSample rdp = GetDataSample(rdpFiles[i]);
-      DataSample mcp = GetDataSample(mcpFiles[i]);
+      if(!job.IsSelected(PlotJob::kSpecies, i))
+      {
+         continue;
+      }
+      Task task;
+      for(unsigned int s = 0; s < 5; ++s)
+      {
+         task.push_back(std::make_pair(speciesSections[s], i));
+      }
+      tasks.push_back(task);
+   }
+   for(unsigned int i = 0; i < job.GetNumIndices(PlotJob::kCombined); ++i)
+   {
+      if(job.IsSelected(PlotJob::kCombined, i))
+      {
+         tasks.push_back(Task(1, std::make_pair(PlotJob::kCombined, i)));
+      }
+   }
 
-      DrawingToolsTPCECal draw(mcpFiles[i]);
+   std::cout.flush();
+   fflush(stdout);
+   bool failed = false;
+   int running = 0;
+   for(unsigned int t = 0; t <= tasks.size(); ++t)
+   {
+      // Wait for a free worker, or for every worker once all have started
+      while(running > 0 && (running == nWorkers || t == tasks.size()))
+      {
+         int status = 0;
+         wait(&status);
+         --running;
+         if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+         {
+            failed = true;
+         }
+      }
+      if(t == tasks.size())
+      {
+         break;
+      }
 
-      PrintSummaryDataUnbinned(draw, rdp, mcp, momentum, downstream,
-         *(particle[i]));
-      PrintSummaryDataUnbinned(draw, rdp, mcp, momentum, barrel,
-         *(particle[i]));
+      pid_t pid = fork();
+      if(pid < 0)
+      {
+         std::cerr << "Could not start worker " << t << std::endl;
+         failed = true;
+         continue;
+      }
+      if(pid == 0)
+      {
+         TCanvas* c1 = CreateCanvas();
+         int status = 0;
+         for(unsigned int s = 0; s < tasks[t].size() && status == 0; ++s)
+         {
+            if(!RedirectOutput(GetSectionOutput(directory, tasks[t][s].first,
+               tasks[t][s].second)))
+            {
+               status = 1;
+               break;
+            }
+            job.Run(tasks[t][s].first, tasks[t][s].second, c1);
+         }
+         delete c1;
+         std::cout.flush();
+         fflush(stdout);
+         _exit(status);
+      }
+      ++running;
    }
 
-   // Print binned summary
-   for(unsigned int i = 0; i < rdpFiles.size(); ++i)
+   // The printed output, in the order of a serial job
+   for(int s = 0; s < PlotJob::kNSections; ++s)
    {
-      DataSample rdp = GetDataSample(rdpFiles[i]);
-      DataSample mcp = GetDataSample(mcpFiles[i]);
-
-      DrawingToolsTPCECal draw(mcpFiles[i]);
-
-      PrintSummaryDataBinned(draw, rdp, mcp, momentum, dsMomBins[i],
-         downstream, *(particle[i]));
-      PrintSummaryDataBinned(draw, rdp, mcp, momentum, brMomBins[i],
-         barrel, *(particle[i]));
-      PrintSummaryDataBinned(draw, rdp, mcp, angle, dsAngBins[i],
-         downstream, *(particle[i]));
-      PrintSummaryDataBinned(draw, rdp, mcp, angle, brAngBins[i],
-         barrel, *(particle[i]));
+      const PlotJob::Section section = PlotJob::Section(s);
+      for(unsigned int i = 0; i < job.GetNumIndices(section); ++i)
+      {
+         const std::string filename = GetSectionOutput(directory, s, i);
+         std::ifstream output(filename.c_str());
+         if(output.is_open() && output.peek() != EOF)
+         {
+            std::cout << output.rdbuf();
+         }
+         output.close();
+         remove(filename.c_str());
+      }
    }
+   rmdir(directory);
 
-   // Print LaTeX-friendly unbinned summary
-   for(unsigned int i = 0; i < rdpFiles.size(); ++i)
+   if(failed)
    {
-      DataSample rdp = GetDataSample(rdpFiles[i]);
-      DataSample mcp = GetDataSample(mcpFiles[i]);
-
-      DrawingToolsTPCECal draw(mcpFiles[i]);
-
-      PrintLaTeXSummaryDataUnbinned(draw, rdp, mcp, momentum, downstream,
-         *(particle[i]));
-      PrintLaTeXSummaryDataUnbinned(draw, rdp, mcp, momentum, barrel,
-         *(particle[i]));
-
-      PrintLaTeXSummaryDataBinned(draw, rdp, mcp, momentum, dsMomBins[i],
-         downstream, *(particle[i]));
-      PrintLaTeXSummaryDataBinned(draw, rdp, mcp, momentum, brMomBins[i],
-         barrel, *(particle[i]));
-      PrintLaTeXSummaryDataBinned(draw, rdp, mcp, angle, dsAngBins[i],
-         downstream, *(particle[i]));
-      PrintLaTeXSummaryDataBinned(draw, rdp, mcp, angle, brAngBins[i],
-         barrel, *(particle[i]));
+      std::cerr << "A plot worker failed" << std::endl;
+      return 1;
    }
 
-   // Draw purities
-   for(unsigned int i = 0; i < rdpFiles.size(); ++i)
+   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+   // -j <n> makes the plots of the species in up to n worker processes at
+   // once, and -s <name> makes only those of one species (e.g. mu) or of one
+   // nu/nubar mode pair (e.g. mulike)
+   int nWorkers = 1;
+   std::string selected;
+   for(int a = 1; a < argc; a += 2)
    {
-      DataSample mcp = GetDataSample(mcpFiles[i]);
+      if(a + 1 < argc && !strcmp(argv[a], "-j"))
+      {
+         nWorkers = atoi(argv[a + 1]);
+      }
+      else if(a + 1 < argc && !strcmp(argv[a], "-s"))
+      {
+         selected = argv[a + 1];
+      }
+      else
+      {
+         std::cerr << "Usage: " << argv[0] << " [-j <n>] [-s <name>]" <<
+            std::endl;
+         return 1;
+      }
+   }
 
-      DrawingToolsTPCECal draw(mcpFiles[i]);
+   gStyle->SetOptStat(0);
 
-      DrawPurity(draw, c1, mcp, downstream, *(particle[i]), i);
-      DrawPurity(draw, c1, mcp, barrel, *(particle[i]), i);
+   PlotJob job;
+   if(!job.Select(selected))
+   {
+      std::cerr << "Error: No species or pair named " << selected <<
+         ". Exiting." << std::endl;
+      return 1;
+   }
+   if(nWorkers > 1)
+   {
+      return RunWorkers(job, nWorkers);
    }
 
+   TCanvas* c1 = CreateCanvas();
+   for(int s = 0; s < PlotJob::kNSections; ++s)
+   {
+      const PlotJob::Section section = PlotJob::Section(s);
+      for(unsigned int i = 0; i < job.GetNumIndices(section); ++i)
+      {
+         if(job.IsSelected(section, i))
+         {
+            job.Run(section, i, c1);
+         }
+      }
+   }
    delete c1;
-   delete e;
-   delete mu;
-   delete p;
-   delete ebar;
-   delete mubar;
+
+   return 0;
 }
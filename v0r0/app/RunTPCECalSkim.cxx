@@ -0,0 +1,236 @@
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "TChain.h"
+#include "TFile.h"
+#include "TTree.h"
+
+/// Identifies an event: run, subrun and event
+typedef std::tuple<Int_t, Int_t, Int_t> EventId;
+
+/// The flat tree branches holding the run, subrun and event of an entry
+const char* const IDBRANCHES[3] = {"sRun", "sSubrun", "sEvt"};
+
+/// Trees with one entry per flat tree entry, which are skimmed with it
+const char* const ALIGNEDTREES[2] = {"NRooTrackerVtx", "GRooTrackerVtx"};
+
+/// Trees with entries per file rather than per event, e.g. the POT, which are
+/// copied whole
+const char* const FILETREES[2] = {"header", "config"};
+
+/**
+   Adds the input flat tree files to a chain.
+
+   \param chain   The chain.
+   \param input   A flat tree file, or a text file listing them.
+*/
+void AddInputFiles(TChain& chain, const std::string& input)
+{
+   if(input.size() > 5 && input.compare(input.size() - 5, 5, ".root") == 0)
+   {
+      chain.Add(input.c_str());
+      return;
+   }
+
+   std::ifstream list(input.c_str());
+   std::string line;
+   while(std::getline(list, line))
+   {
+      if(!line.empty())
+      {
+         chain.Add(line.c_str());
+      }
+   }
+}
+
+/**
+   Reads the events of a preselection index.
+
+   \param filename   The index file written by RunTPCECalSystematicsAnalysis.
+   \param events  Filled with the events.
+   \return  True if the index was read, False otherwise.
+*/
+bool ReadIndex(const std::string& filename, std::set<EventId>& events)
+{
+   TFile file(filename.c_str(), "READ");
+   TTree* tree = file.IsZombie() ? nullptr :
+      static_cast<TTree*>(file.Get("preselection"));
+   if(!tree)
+   {
+      std::cerr << "No preselection index in " << filename << std::endl;
+      return false;
+   }
+
+   Int_t run = 0;
+   Int_t subrun = 0;
+   Int_t event = 0;
+   tree->SetBranchAddress("run", &run);
+   tree->SetBranchAddress("subrun", &subrun);
+   tree->SetBranchAddress("event", &event);
+   for(Long64_t i = 0; i < tree->GetEntries(); ++i)
+   {
+      tree->GetEntry(i);
+      events.insert(EventId(run, subrun, event));
+   }
+
+   return true;
+}
+
+/**
+   Finds the flat tree entries of the indexed events. Only the run, subrun and
+   event branches are read.
+
+   \param chain   The flat tree chain.
+   \param events  The indexed events.
+   \param entries Filled with the entries, in increasing order.
+   \return  True if the entries were found, False otherwise.
+*/
+bool FindEntries(TChain& chain, const std::set<EventId>& events,
+   std::vector<Long64_t>& entries)
+{
+   Int_t id[3] = {0, 0, 0};
+   chain.SetBranchStatus("*", false);
+   for(unsigned int i = 0; i < 3; ++i)
+   {
+      if(!chain.GetBranch(IDBRANCHES[i]))
+      {
+         std::cerr << "The flat tree has no " << IDBRANCHES[i] << " branch" <<
+            std::endl;
+         return false;
+      }
+      chain.SetBranchStatus(IDBRANCHES[i], true);
+      chain.SetBranchAddress(IDBRANCHES[i], &id[i]);
+   }
+
+   for(Long64_t entry = 0; entry < chain.GetEntries(); ++entry)
+   {
+      chain.GetEntry(entry);
+      if(events.count(EventId(id[0], id[1], id[2])))
+      {
+         entries.push_back(entry);
+      }
+   }
+
+   chain.ResetBranchAddresses();
+   chain.SetBranchStatus("*", true);
+
+   return true;
+}
+
+/**
+   Copies some entries of a chain into a new tree of a file.
+
+   \param chain   The chain.
+   \param entries The entries, in increasing order.
+   \param output  The file.
+*/
+void CopyEntries(TChain& chain, const std::vector<Long64_t>& entries,
+   TFile& output)
+{
+   output.cd();
+   TTree* skim = chain.CloneTree(0);
+   for(unsigned int i = 0; i < entries.size(); ++i)
+   {
+      chain.GetEntry(entries[i]);
+      skim->Fill();
+   }
+   skim->Write();
+}
+
+/**
+   Copies the flat tree entries of the events in a preselection index, and the
+   trees that go with them, into a new, smaller, flat tree file. Running the
+   analysis over it selects the same events as running over the inputs, but
+   only reads the entries that can pass the preselection.
+
+   The skim does NOT hold the true vertices of the spills it drops, so a truth
+   tree made from it would miss most of the signal. The analysis recognises a
+   skim and writes no truth tree for it: efficiencies and other truth based
+   quantities must come from a run over the full input.
+
+   The file also holds a tree of the input file and entry of each copied
+   entry, skimentries, which is what marks it as a skim.
+
+   Usage: RunTPCECalSkim <index file> <input> <output file>
+   where the input is a flat tree file or a text file listing them.
+*/
+int main(int argc, char *argv[])
+{
+   if(argc != 4)
+   {
+      std::cerr << "Usage: " << argv[0] << " <index file> <input> " <<
+         "<output file>" << std::endl;
+      return 1;
+   }
+
+   std::set<EventId> events;
+   if(!ReadIndex(argv[1], events))
+   {
+      return 1;
+   }
+
+   TChain flattree("flattree");
+   AddInputFiles(flattree, argv[2]);
+   std::vector<Long64_t> entries;
+   if(!FindEntries(flattree, events, entries))
+   {
+      return 1;
+   }
+
+   TFile output(argv[3], "RECREATE");
+   if(output.IsZombie())
+   {
+      std::cerr << "Could not create " << argv[3] << std::endl;
+      return 1;
+   }
+
+   CopyEntries(flattree, entries, output);
+
+   for(unsigned int t = 0; t < 2; ++t)
+   {
+      TChain aligned(ALIGNEDTREES[t]);
+      AddInputFiles(aligned, argv[2]);
+      if(aligned.GetEntries() == flattree.GetEntries())
+      {
+         CopyEntries(aligned, entries, output);
+      }
+   }
+
+   for(unsigned int t = 0; t < 2; ++t)
+   {
+      TChain perFile(FILETREES[t]);
+      AddInputFiles(perFile, argv[2]);
+      if(perFile.GetEntries() > 0)
+      {
+         output.cd();
+         perFile.CloneTree(-1, "fast")->Write();
+      }
+   }
+
+   // Where each copied entry came from
+   output.cd();
+   std::string inputFile;
+   Long64_t inputEntry = 0;
+   TTree* sources = new TTree("skimentries",
+      "Input file and entry of each skimmed entry");
+   sources->Branch("file", &inputFile);
+   sources->Branch("entry", &inputEntry, "entry/L");
+   for(unsigned int i = 0; i < entries.size(); ++i)
+   {
+      flattree.LoadTree(entries[i]);
+      inputFile = flattree.GetFile()->GetName();
+      inputEntry = entries[i] - flattree.GetChainOffset();
+      sources->Fill();
+   }
+   sources->Write();
+
+   std::cout << "Skimmed " << entries.size() << " of " <<
+      flattree.GetEntries() << " entries. The skim has no truth tree " <<
+      "contribution from the other entries." << std::endl;
+   output.Close();
+
+   return 0;
+}
@@ -1,8 +1,644 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "TPCECalSystematicsAnalysis.hxx"
 #include "AnalysisLoop.hxx"
+#include "TPCECalSelection.hxx"
+#include "StepProfiler.hxx"
+#include "StepCheckpoint.hxx"
+#include "ThresholdScan.hxx"
+#include "PreselectionIndex.hxx"
+#include "MicroTreeMerger.hxx"
+#include "TChain.h"
+#include "TFile.h"
+
+/**
+   Finds the value of an option in a list of arguments.
+
+   \param args The arguments.
+   \param option  The option, e.g. "-o".
+   \return  The value of the option, or NULL if it was not given.
+*/
+const char* GetOption(const std::vector<char*>& args, const char* option)
+{
+   for(unsigned int i = 1; i + 1 < args.size(); ++i)
+   {
+      if(!strcmp(args[i], option))
+      {
+         return args[i + 1];
+      }
+   }
+
+   return nullptr;
+}
+
+/**
+   Runs the analysis loop over the given arguments.
+
+   \param args The arguments, as they would be given to AnalysisLoop.
+   \param worker  Whether this is a worker of RunWorkers. A worker only writes
+                  its step profile, which RunWorkers sums over the workers and
+                  prints.
+   \return  The exit status.
+*/
+int RunAnalysis(std::vector<char*> args, const bool worker = false)
+{
+   int argc = args.size();
+   args.push_back(nullptr);
 
-int main(int argc, char *argv[]){
    TPCECalSystematicsAnalysis* ana = new TPCECalSystematicsAnalysis();
-   AnalysisLoop loop(ana, argc, argv); 
+   AnalysisLoop loop(ana, argc, &args[0]);
    loop.Execute();
+
+   // Report the events whose candidates outgrew the space sized for them
+   if(TPCBackSegmentCache::GetNumOverflows() ||
+      TrackCandidateSet::GetNumOverflows() ||
+      TrackPairCandidateSet::GetNumOverflows())
+   {
+      std::cout << "Events grown past the candidate capacity: " <<
+         TPCBackSegmentCache::GetNumOverflows() << " segment cache, " <<
+         TrackCandidateSet::GetNumOverflows() << " track set, " <<
+         TrackPairCandidateSet::GetNumOverflows() << " pair set" << std::endl;
+   }
+
+   // Report the step profile and add it, and the threshold scan, to the
+   // output file
+   const char* output = GetOption(args, "-o");
+   StepProfiler& profiler = StepProfiler::Get();
+   if(profiler.IsEnabled())
+   {
+      if(!worker)
+      {
+         profiler.Print();
+      }
+      if(output)
+      {
+         profiler.Write(output);
+      }
+   }
+
+   ThresholdScan& scan = ThresholdScan::Get();
+   if(scan.IsEnabled() && output)
+   {
+      scan.Write(output);
+   }
+
+   StepCheckpointer::Get().Close();
+
+   PreselectionIndex& index = PreselectionIndex::Get();
+   if(index.IsEnabled() && !index.Write())
+   {
+      return 1;
+   }
+
+   return 0;
+}
+
+/**
+   Reads the flat tree files of the input.
+
+   \param input   A flat tree file, or a text file listing them.
+   \return  The files.
+*/
+std::vector<std::string> ReadInputFiles(const std::string& input)
+{
+   std::vector<std::string> files;
+   if(input.size() > 5 && input.compare(input.size() - 5, 5, ".root") == 0)
+   {
+      files.push_back(input);
+      return files;
+   }
+
+   std::ifstream list(input.c_str());
+   std::string line;
+   while(std::getline(list, line))
+   {
+      if(!line.empty())
+      {
+         files.push_back(line);
+      }
+   }
+
+   return files;
+}
+
+/**
+   Counts the entries of the input flat trees.
+
+   \param input   A flat tree file, or a text file listing them.
+   \return  The number of entries.
+*/
+Long64_t CountInputEntries(const std::string& input)
+{
+   TChain chain("flattree");
+   const std::vector<std::string> files = ReadInputFiles(input);
+   for(unsigned int i = 0; i < files.size(); ++i)
+   {
+      chain.Add(files[i].c_str());
+   }
+
+   return chain.GetEntries();
+}
+
+/**
+   Checks whether the input is a skim made by RunTPCECalSkim, which marks its
+   output with a skimentries tree.
+
+   \param input   A flat tree file, or a text file listing them.
+   \return  True if the first file of the input is a skim, False otherwise.
+*/
+bool IsSkim(const std::string& input)
+{
+   const std::vector<std::string> files = ReadInputFiles(input);
+   if(files.empty())
+   {
+      return false;
+   }
+
+   TFile file(files[0].c_str(), "READ");
+   return !file.IsZombie() && file.Get("skimentries");
+}
+
+/**
+   Writes one shard of an input list, a consecutive block of its files, to a
+   list of its own. The shards of N are as equal in size as they can be.
+
+   \param input   The input list.
+   \param shard   The shard, from 0 to nShards - 1.
+   \param nShards The number of shards.
+   \param list The list to write.
+   \return  True if the shard has files and was written, False otherwise.
+*/
+bool WriteShardList(const std::string& input, const int shard,
+   const int nShards, const std::string& list)
+{
+   const std::vector<std::string> files = ReadInputFiles(input);
+   const unsigned int begin = files.size() * shard / nShards;
+   const unsigned int end = files.size() * (shard + 1) / nShards;
+   if(begin == end)
+   {
+      std::cerr << "Shard " << shard << " of " << nShards << " of " << input <<
+         " has no files" << std::endl;
+      return false;
+   }
+
+   std::ofstream out(list.c_str());
+   for(unsigned int i = begin; i < end; ++i)
+   {
+      out << files[i] << std::endl;
+   }
+
+   return out.good();
+}
+
+/**
+   Stops the workers that have been started and deletes the files they write.
+
+   \param pids The process of each worker started.
+   \param parts  The files the workers write.
+*/
+void StopWorkers(const std::vector<pid_t>& pids,
+   const std::vector<std::string>& parts)
+{
+   for(unsigned int w = 0; w < pids.size(); ++w)
+   {
+      kill(pids[w], SIGTERM);
+   }
+   for(unsigned int w = 0; w < pids.size(); ++w)
+   {
+      waitpid(pids[w], nullptr, 0);
+   }
+   for(unsigned int i = 0; i < parts.size(); ++i)
+   {
+      std::remove(parts[i].c_str());
+   }
+}
+
+/**
+   Runs the analysis in several worker processes and merges their outputs in
+   the order of the workers.
+
+   Each worker is a complete, independent analysis job, so if the workers
+   process consecutive parts of the input the merged output is the same as
+   that of a single job.
+
+   \param args The arguments, without the -j or --shards option and the
+               input file.
+   \param workerArgs   The extra arguments of each worker, ending with its
+                       input file.
+   \param output  The output file.
+   \param checkpoint The checkpoint file to save, or empty for none. Each
+                     worker saves its own, and they are merged like the
+                     outputs.
+   \param resume  The checkpoint file to resume from, or empty for none.
+   \param index   The preselection index file to write, or empty for none.
+                  Each worker writes its own, and they are merged like the
+                  outputs.
+   \param sharedInput   Whether every worker reads the same input files. Each
+                        worker then writes the header of every file, so only
+                        the first one's is kept, or the POT would be counted
+                        once per worker.
+   \return  The exit status.
+*/
+int RunWorkers(const std::vector<std::string>& args,
+   const std::vector<std::vector<std::string> >& workerArgs,
+   const std::string& output, const std::string& checkpoint,
+   const std::string& resume, const std::string& index,
+   const bool sharedInput)
+{
+   MicroTreeMerger merger(output);
+   if(sharedInput)
+   {
+      merger.KeepFirstOnly("header");
+   }
+   MicroTreeMerger checkpointMerger(checkpoint);
+   MicroTreeMerger indexMerger(index);
+   std::vector<pid_t> pids;
+   std::vector<std::string> parts;
+   for(unsigned int w = 0; w < workerArgs.size(); ++w)
+   {
+      std::ostringstream part;
+      part << output << ".part" << w;
+      merger.AddFile(part.str());
+      parts.push_back(part.str());
+
+      std::ostringstream checkpointPart;
+      if(!checkpoint.empty())
+      {
+         checkpointPart << checkpoint << ".part" << w;
+         checkpointMerger.AddFile(checkpointPart.str());
+         parts.push_back(checkpointPart.str());
+      }
+
+      std::ostringstream indexPart;
+      if(!index.empty())
+      {
+         indexPart << index << ".part" << w;
+         indexMerger.AddFile(indexPart.str());
+         parts.push_back(indexPart.str());
+      }
+
+      std::vector<std::string> jobArgs(args);
+      jobArgs.push_back("-o");
+      jobArgs.push_back(part.str());
+      jobArgs.insert(jobArgs.end(), workerArgs[w].begin(),
+         workerArgs[w].end());
+
+      pid_t pid = fork();
+      if(pid < 0)
+      {
+         // The workers already started would leave partial outputs behind
+         std::cerr << "Could not start worker " << w << std::endl;
+         StopWorkers(pids, parts);
+         return 1;
+      }
+      if(pid == 0)
+      {
+         std::vector<char*> argv;
+         for(unsigned int i = 0; i < jobArgs.size(); ++i)
+         {
+            argv.push_back(const_cast<char*>(jobArgs[i].c_str()));
+         }
+         StepCheckpointer::Get().SetFiles(checkpointPart.str(), resume);
+         PreselectionIndex::Get().SetFile(indexPart.str());
+         int status = RunAnalysis(argv, true);
+         std::cout.flush();
+         std::cerr.flush();
+         _exit(status);
+      }
+      pids.push_back(pid);
+   }
+
+   bool failed = false;
+   for(unsigned int w = 0; w < pids.size(); ++w)
+   {
+      int status = 0;
+      waitpid(pids[w], &status, 0);
+      if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      {
+         std::cerr << "Worker " << w << " failed" << std::endl;
+         failed = true;
+      }
+   }
+   if(failed)
+   {
+      return 1;
+   }
+
+   if(!checkpoint.empty() && !checkpointMerger.Merge(true))
+   {
+      return 1;
+   }
+
+   if(!index.empty() && !indexMerger.Merge(true))
+   {
+      return 1;
+   }
+
+   if(!merger.Merge(true))
+   {
+      return 1;
+   }
+
+   // The merged output has a row of the step profile per worker per step.
+   // They are summed into one.
+   StepProfiler& profiler = StepProfiler::Get();
+   if(profiler.Read(output))
+   {
+      profiler.Print();
+      profiler.Write(output);
+   }
+
+   return 0;
+}
+
+/**
+   Copies the arguments, leaving out the output and input files and any of the
+   given options.
+
+   \param args The arguments. The last one must be the input file.
+   \param skipRange  Whether to also leave out the -s and -n options.
+   \return  The arguments.
+*/
+std::vector<std::string> GetCommonArgs(const std::vector<char*>& args,
+   const bool skipRange)
+{
+   std::vector<std::string> common;
+   for(unsigned int i = 0; i + 1 < args.size(); ++i)
+   {
+      if(!strcmp(args[i], "-o") ||
+         (skipRange && (!strcmp(args[i], "-s") || !strcmp(args[i], "-n"))))
+      {
+         ++i;
+         continue;
+      }
+      common.push_back(args[i]);
+   }
+
+   return common;
+}
+
+/**
+   Runs the analysis in several worker processes, each over a consecutive range
+   of events, using the -s and -n options of AnalysisLoop.
+
+   \param args The arguments, without the -j option. The last one must be the
+               input file.
+   \param nWorkers   The number of workers.
+   \param checkpoint The checkpoint file to save, or empty for none.
+   \param resume  The checkpoint file to resume from, or empty for none.
+   \param index   The preselection index file to write, or empty for none.
+   \return  The exit status.
+*/
+int RunEventWorkers(const std::vector<char*>& args, const int nWorkers,
+   const std::string& checkpoint, const std::string& resume,
+   const std::string& index)
+{
+   const char* output = GetOption(args, "-o");
+   if(!output || args.size() < 2)
+   {
+      std::cerr << "-j needs an output file (-o) and an input file" <<
+         std::endl;
+      return 1;
+   }
+
+   // The range of events to process, honouring any -s and -n given
+   const char* skipOption = GetOption(args, "-s");
+   const char* nmaxOption = GetOption(args, "-n");
+   Long64_t first = skipOption ? atoll(skipOption) : 0;
+   Long64_t last = CountInputEntries(args.back());
+   if(nmaxOption && first + atoll(nmaxOption) < last)
+   {
+      last = first + atoll(nmaxOption);
+   }
+   Long64_t perWorker = (last - first + nWorkers - 1) / nWorkers;
+
+   std::vector<std::vector<std::string> > workerArgs;
+   for(int w = 0; w < nWorkers; ++w)
+   {
+      Long64_t start = first + w * perWorker;
+      Long64_t count = std::min(perWorker, last - start);
+      if(count <= 0)
+      {
+         break;
+      }
+
+      std::ostringstream skip;
+      skip << start;
+      std::ostringstream nmax;
+      nmax << count;
+
+      std::vector<std::string> range;
+      range.push_back("-s");
+      range.push_back(skip.str());
+      range.push_back("-n");
+      range.push_back(nmax.str());
+      range.push_back(args.back());
+      workerArgs.push_back(range);
+   }
+
+   return RunWorkers(GetCommonArgs(args, true), workerArgs, output,
+      checkpoint, resume, index, true);
+}
+
+/**
+   Runs the analysis in several worker processes, each over one shard of the
+   input list, and merges their outputs in list order. Unlike -j, each worker
+   only opens the files of its own shard.
+
+   \param args The arguments, without the --shards option. The last one must
+               be the input list.
+   \param nShards The number of shards.
+   \param checkpoint The checkpoint file to save, or empty for none.
+   \param resume  The checkpoint file to resume from, or empty for none.
+   \param index   The preselection index file to write, or empty for none.
+   \return  The exit status.
+*/
+int RunShardWorkers(const std::vector<char*>& args, const int nShards,
+   const std::string& checkpoint, const std::string& resume,
+   const std::string& index)
+{
+   const char* output = GetOption(args, "-o");
+   if(!output || args.size() < 2)
+   {
+      std::cerr << "--shards needs an output file (-o) and an input list" <<
+         std::endl;
+      return 1;
+   }
+
+   // Fewer files than shards leaves the extra shards empty, so they are not
+   // run
+   const int nFiles = ReadInputFiles(args.back()).size();
+   const int nWorkers = std::min(nShards, nFiles);
+   std::vector<std::vector<std::string> > workerArgs;
+   for(int w = 0; w < nWorkers; ++w)
+   {
+      std::ostringstream list;
+      list << output << ".shard" << w << ".list";
+      if(!WriteShardList(args.back(), w, nWorkers, list.str()))
+      {
+         return 1;
+      }
+      workerArgs.push_back(std::vector<std::string>(1, list.str()));
+   }
+
+   int status = RunWorkers(GetCommonArgs(args, false), workerArgs, output,
+      checkpoint, resume, index, false);
+
+   for(unsigned int w = 0; w < workerArgs.size(); ++w)
+   {
+      std::remove(workerArgs[w].back().c_str());
+   }
+
+   return status;
+}
+
+/**
+   Runs the analysis over one shard of the input list, e.g. on one of several
+   batch nodes. The outputs of the shards are merged with RunTPCECalMerge.
+
+   \param args The arguments, without the --shard option. The last one must
+               be the input list.
+   \param shard   The shard, from 0 to nShards - 1.
+   \param nShards The number of shards.
+   \param nWorkers   The number of workers to run the shard with.
+   \param checkpoint The checkpoint file to save, or empty for none.
+   \param resume  The checkpoint file to resume from, or empty for none.
+   \param index   The preselection index file to write, or empty for none.
+   \return  The exit status.
+*/
+int RunShard(std::vector<char*> args, const int shard, const int nShards,
+   const int nWorkers, const std::string& checkpoint,
+   const std::string& resume, const std::string& index)
+{
+   const char* output = GetOption(args, "-o");
+   if(!output || args.size() < 2 || shard < 0 || shard >= nShards)
+   {
+      std::cerr << "--shard k/N needs 0 <= k < N, an output file (-o) and an "
+         "input list" << std::endl;
+      return 1;
+   }
+
+   const std::string list = std::string(output) + ".list";
+   if(!WriteShardList(args.back(), shard, nShards, list))
+   {
+      return 1;
+   }
+   args.back() = const_cast<char*>(list.c_str());
+
+   int status = 0;
+   if(nWorkers > 1)
+   {
+      status = RunEventWorkers(args, nWorkers, checkpoint, resume, index);
+   }
+   else
+   {
+      StepCheckpointer::Get().SetFiles(checkpoint, resume);
+      PreselectionIndex::Get().SetFile(index);
+      status = RunAnalysis(args);
+   }
+
+   std::remove(list.c_str());
+
+   return status;
+}
+
+int main(int argc, char *argv[]){
+   // -j <n> runs n worker processes over ranges of events, --shards <n> runs
+   // n over shards of the input list, --shard <k>/<n> runs only the kth of n
+   // shards, --checkpoint <file> saves a checkpoint of the selection steps,
+   // --resume <file> resumes from one and --index <file> writes the
+   // preselection index for RunTPCECalSkim. They are handled here rather than
+   // by AnalysisLoop, so are removed from the arguments.
+   int nWorkers = 1;
+   int nShards = 1;
+   int shard = -1;
+   std::string checkpoint;
+   std::string resume;
+   std::string index;
+   std::vector<char*> args;
+   for(int i = 0; i < argc; ++i)
+   {
+      if(!strcmp(argv[i], "-j") && i + 1 < argc)
+      {
+         nWorkers = atoi(argv[++i]);
+         continue;
+      }
+      if(!strcmp(argv[i], "--shards") && i + 1 < argc)
+      {
+         nShards = atoi(argv[++i]);
+         continue;
+      }
+      if(!strcmp(argv[i], "--shard") && i + 1 < argc)
+      {
+         if(sscanf(argv[++i], "%d/%d", &shard, &nShards) != 2)
+         {
+            std::cerr << "--shard takes k/N, e.g. 0/4" << std::endl;
+            return 1;
+         }
+         continue;
+      }
+      if(!strcmp(argv[i], "--checkpoint") && i + 1 < argc)
+      {
+         checkpoint = argv[++i];
+         continue;
+      }
+      if(!strcmp(argv[i], "--resume") && i + 1 < argc)
+      {
+         resume = argv[++i];
+         continue;
+      }
+      if(!strcmp(argv[i], "--index") && i + 1 < argc)
+      {
+         index = argv[++i];
+         continue;
+      }
+      args.push_back(argv[i]);
+   }
+
+   // The workers inherit this
+   if(args.size() > 1 && IsSkim(args.back()))
+   {
+      std::cerr << "WARNING: " << args.back() << " is a skim, which only " <<
+         "holds the spills that can pass the preselection. Its truth tree " <<
+         "would miss the signal vertices of every other spill, so none is " <<
+         "written. Take efficiencies and other truth based quantities from " <<
+         "a run over the full input." << std::endl;
+      TPCECalSystematicsAnalysis::SetSkimmedInput(true);
+   }
+
+   if(shard >= 0)
+   {
+      return RunShard(args, shard, nShards, nWorkers, checkpoint, resume,
+         index);
+   }
+
+   if(nShards > 1 && nWorkers > 1)
+   {
+      std::cerr << "--shards and -j cannot be combined: both set the number " <<
+         "of worker processes. Use --shards alone, or -j with --shard k/N." <<
+         std::endl;
+      return 1;
+   }
+
+   if(nShards > 1)
+   {
+      return RunShardWorkers(args, nShards, checkpoint, resume, index);
+   }
+
+   if(nWorkers > 1)
+   {
+      return RunEventWorkers(args, nWorkers, checkpoint, resume, index);
+   }
+
+   StepCheckpointer::Get().SetFiles(checkpoint, resume);
+   PreselectionIndex::Get().SetFile(index);
+   return RunAnalysis(args);
 }
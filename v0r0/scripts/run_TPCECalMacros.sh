@@ -38,3 +38,21 @@ export MUBAR_RDP_FILE=$TN228HOME/microtrees/${TESTDIR}rdp_mubar.root
 export P_MCP_FILE=$TN228HOME/microtrees/${TESTDIR}mcp_p.root
 export P_RDP_FILE=$TN228HOME/microtrees/${TESTDIR}rdp_p.root
 
+# Microtrees from a single pass over all selections hold every species
+if [ "${ALLSELECTIONS}" ]; then
+   for var in E MU P; do
+      export ${var}_MCP_FILE=$TN228HOME/microtrees/${TESTDIR}mcp_nu.root
+      export ${var}_RDP_FILE=$TN228HOME/microtrees/${TESTDIR}rdp_nu.root
+   done
+   for var in EBAR MUBAR; do
+      export ${var}_MCP_FILE=$TN228HOME/microtrees/${TESTDIR}mcp_nubar.root
+      export ${var}_RDP_FILE=$TN228HOME/microtrees/${TESTDIR}rdp_nubar.root
+   done
+fi
+
+# To keep efficiencies between runs the EFFICIENCY_CACHE environment variable
+# should be set. They are recomputed if a micro-tree changes or the compiled
+# signals and cuts of the plotting change.
+if [ "${EFFICIENCY_CACHE}" ]; then
+   export EFFICIENCY_CACHE_FILE=$TN228HOME/microtrees/${TESTDIR}efficiencies.cache
+fi
@@ -47,16 +47,44 @@ else
    kill -INT $$
 fi
 
+# If the SHARDS environment variable is set each input list is split into that
+# many shards, which are run concurrently and merged into the usual output
+if [ "${SHARDS}" ]; then
+   export SHARDOPTS="--shards ${SHARDS}"
+else
+   export SHARDOPTS=
+fi
+
 cd $TN228HOME
 source $ND280PATH/highland2Systematics/TPCECalSystematicsAnalysis/v*/cmt/setup.sh
 
+# If the ALLSELECTIONS environment variable is set every selection is run in a
+# single pass over each input list, reading the inputs 4 times rather than 10
+if [ "${ALLSELECTIONS}" ]; then
+   pids=""
+   param=${ND280PATH}/highland2Systematics/TPCECalSystematicsAnalysis/v0r0/parameters/TPCECalSystematicsAnalysis.all.parameters.dat
+   for sample in rdp_nu:neutrino mcp_nu:mcneutrino rdp_nubar:antineutrino mcp_nubar:mcantineutrino; do
+      name=${sample%%:*}
+      output=$TN228HOME/microtrees/${TESTDIR}${name}.root
+      input=$TN228HOME/input_files/${TESTDIR}${sample##*:}_flattrees.list
+      log=$TN228HOME/logs/${TESTDIR}TestTPCECal_${name}.log
+      rm ${output}
+      RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
+
+      pids="$pids $!"
+   done
+   wait $pids
+   echo "Finished"
+   exit 0
+fi
+
 pids=""
 param=${ND280PATH}/highland2Systematics/TPCECalSystematicsAnalysis/v0r0/parameters/TPCECalSystematicsAnalysis.e.parameters.dat
 output=$TN228HOME/microtrees/${TESTDIR}rdp_e.root
 input=$TN228HOME/input_files/${TESTDIR}neutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_rdp_e.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 
@@ -65,7 +93,7 @@ output=$TN228HOME/microtrees/${TESTDIR}rdp_mu.root
 input=$TN228HOME/input_files/${TESTDIR}neutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_rdp_mu.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 
@@ -74,7 +102,7 @@ output=$TN228HOME/microtrees/${TESTDIR}rdp_p.root
 input=$TN228HOME/input_files/${TESTDIR}neutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_rdp_p.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 wait $pids
@@ -86,7 +114,7 @@ output=$TN228HOME/microtrees/${TESTDIR}mcp_e.root
 input=$TN228HOME/input_files/${TESTDIR}mcneutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_mcp_e.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 
@@ -95,7 +123,7 @@ output=$TN228HOME/microtrees/${TESTDIR}mcp_mu.root
 input=$TN228HOME/input_files/${TESTDIR}mcneutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_mcp_mu.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 
@@ -104,7 +132,7 @@ output=$TN228HOME/microtrees/${TESTDIR}mcp_p.root
 input=$TN228HOME/input_files/${TESTDIR}mcneutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_mcp_p.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 wait $pids
@@ -116,7 +144,7 @@ output=$TN228HOME/microtrees/${TESTDIR}rdp_ebar.root
 input=$TN228HOME/input_files/${TESTDIR}antineutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_rdp_ebar.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 
@@ -125,7 +153,7 @@ output=$TN228HOME/microtrees/${TESTDIR}rdp_mubar.root
 input=$TN228HOME/input_files/${TESTDIR}antineutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_rdp_mubar.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 wait $pids
@@ -137,7 +165,7 @@ output=$TN228HOME/microtrees/${TESTDIR}mcp_ebar.root
 input=$TN228HOME/input_files/${TESTDIR}mcantineutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_mcp_ebar.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 
@@ -146,7 +174,7 @@ output=$TN228HOME/microtrees/${TESTDIR}mcp_mubar.root
 input=$TN228HOME/input_files/${TESTDIR}mcantineutrino_flattrees.list
 log=$TN228HOME/logs/${TESTDIR}TestTPCECal_mcp_mubar.log
 rm ${output}
-RunTPCECalSystematicsAnalysis.exe -p ${param} -o ${output} ${input} > ${log} &
+RunTPCECalSystematicsAnalysis.exe ${SHARDOPTS} -p ${param} -o ${output} ${input} > ${log} &
 
 pids="$pids $!"
 wait $pids
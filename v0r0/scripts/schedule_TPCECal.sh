@@ -0,0 +1,165 @@
+#!/bin/bash
+# Runs the analysis jobs and plot stages of a manifest, up to N at once.
+#
+# Usage: schedule_TPCECal.sh [-j N] <manifest>
+#
+# Each line of the manifest is one of
+#    env <VARIABLE>=<value>
+#    job <parameters file> <input list> <output file> <log file> [options...]
+#    plot <name> <log file> <micro-tree files...>
+# where a job runs RunTPCECalSystematicsAnalysis, passing it any extra
+# options (e.g. --shards 4), and a plot stage runs RunTPCECalPlot with the env
+# variables set, for the species or nu/nubar mode pair of the name (e.g. mu or
+# mulike), or for all of them if the name is all. Shell variables in the manifest are expanded, # starts a
+# comment and a \ at the end of a line continues it.
+#
+# There are no barriers: a job starts as soon as there is a free slot, and a
+# plot stage as soon as all of its micro-trees exist and none of them is still
+# being written by a job. A job is skipped if its output is newer than its
+# parameters file, input list and every file in the list, and a plot stage if
+# its log is newer than its micro-trees and none of them is to be rewritten by
+# a job. N defaults to the number of cores.
+
+nSlots=$(nproc)
+if [ "$1" = "-j" ]; then
+   nSlots=$2
+   shift 2
+fi
+
+if [ $# -ne 1 ] || [ ! -f "$1" ]; then
+   echo "Usage: $0 [-j N] <manifest>"
+   exit 1
+fi
+
+jobs=()
+plots=()
+while read line; do
+   line=${line%%#*}
+   eval "fields=($line)"
+   [ ${#fields[@]} -eq 0 ] && continue
+   case ${fields[0]} in
+      env)
+         export "${fields[1]}"
+         ;;
+      job)
+         jobs+=("${fields[*]:1}")
+         ;;
+      plot)
+         plots+=("${fields[*]:1}")
+         ;;
+      *)
+         echo "Unknown manifest entry: ${fields[0]}"
+         exit 1
+         ;;
+   esac
+done < "$1"
+
+# Checks whether a file is newer than all of the others
+isNewer() {
+   local target=$1
+   shift
+   [ -e "$target" ] || return 1
+   for file in "$@"; do
+      [ "$target" -nt "$file" ] || return 1
+   done
+   return 0
+}
+
+# The outputs of the jobs that have not finished, which plot stages wait on
+pending=" "
+for ((i = 0; i < ${#jobs[@]}; ++i)); do
+   set -- ${jobs[$i]}
+   if isNewer "$3" "$1" "$2" $(cat "$2"); then
+      echo "Skipping $3, which is up to date"
+      jobs[$i]=
+   else
+      pending="$pending$3 "
+   fi
+done
+for ((i = 0; i < ${#plots[@]}; ++i)); do
+   set -- ${plots[$i]}
+   log=$2
+   shift 2
+   # A micro-tree still to be written makes the plots stale, however old
+   for file in "$@"; do
+      [[ $pending == *" $file "* ]] && continue 2
+   done
+   if isNewer "$log" "$@"; then
+      echo "Skipping the plots of $log, which are up to date"
+      plots[$i]=
+   fi
+done
+
+# Checks whether all of the micro-trees of a plot stage are ready
+isReady() {
+   for file in "$@"; do
+      [ -e "$file" ] || return 1
+      [[ $pending == *" $file "* ]] && return 1
+   done
+   return 0
+}
+
+declare -A running
+failed=0
+while true; do
+   # Start whatever is ready, jobs first, while there are free slots
+   for ((i = 0; i < ${#jobs[@]} && ${#running[@]} < nSlots; ++i)); do
+      [ -z "${jobs[$i]}" ] && continue
+      set -- ${jobs[$i]}
+      param=$1 input=$2 output=$3 log=$4
+      shift 4
+      rm -f "$output"
+      echo "Starting $output"
+      RunTPCECalSystematicsAnalysis.exe "$@" -p "$param" -o "$output" \
+         "$input" > "$log" 2>&1 &
+      running[$!]=$output
+      jobs[$i]=
+   done
+   for ((i = 0; i < ${#plots[@]} && ${#running[@]} < nSlots; ++i)); do
+      [ -z "${plots[$i]}" ] && continue
+      set -- ${plots[$i]}
+      name=$1 log=$2
+      shift 2
+      isReady "$@" || continue
+      echo "Starting the plots of $log"
+      if [ "$name" = "all" ]; then
+         RunTPCECalPlot.exe > "$log" 2>&1 &
+      else
+         RunTPCECalPlot.exe -s "$name" > "$log" 2>&1 &
+      fi
+      running[$!]=
+      plots[$i]=
+   done
+
+   if [ ${#running[@]} -eq 0 ]; then
+      break
+   fi
+
+   # Collect every process that has finished
+   wait -n
+   for pid in "${!running[@]}"; do
+      kill -0 $pid 2> /dev/null && continue
+      wait $pid
+      status=$?
+      output=${running[$pid]}
+      unset running[$pid]
+      # The output of a failed job stays pending, so nothing plots it
+      if [ $status -ne 0 ]; then
+         echo "Process $pid (${output:-plots}) failed with status $status"
+         failed=1
+      elif [ -n "$output" ]; then
+         pending=${pending/ $output / }
+      fi
+   done
+done
+
+for plot in "${plots[@]}"; do
+   if [ -n "$plot" ]; then
+      set -- $plot
+      echo "Never started the plots of $2, as a micro-tree is missing"
+      failed=1
+   fi
+done
+
+echo "Finished"
+exit $failed
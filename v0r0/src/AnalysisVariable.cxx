@@ -4,14 +4,16 @@ namespace TPCECalSystematics
 {
 
 AnalysisVariable::AnalysisVariable(const std::string& microtreeVariable,
-   const std::string& name, const std::string& description):
-   _microtreeVariable(microtreeVariable), _name(name), _description(description)
+   const std::string& name, const std::string& description,
+   MicroTreeAccessor accessor):
+   _microtreeVariable(microtreeVariable), _name(name),
+   _description(description), _accessor(accessor)
 {
 }
 
 AnalysisVariable::AnalysisVariable(const AnalysisVariable& variable):
    _microtreeVariable(variable._microtreeVariable), _name(variable._name),
-   _description(variable._description)
+   _description(variable._description), _accessor(variable._accessor)
 {
 }
 
@@ -20,6 +22,7 @@ AnalysisVariable& AnalysisVariable::operator=(const AnalysisVariable& variable)
    _microtreeVariable = variable._microtreeVariable;
    _name = variable._name;
    _description = variable._description;
+   _accessor = variable._accessor;
 
    return *this;
 }
@@ -43,4 +46,9 @@ const std::string& AnalysisVariable::GetDescription() const
    return _description;
 }
 
+MicroTreeAccessor AnalysisVariable::GetAccessor() const
+{
+   return _accessor;
+}
+
 }
@@ -2,6 +2,7 @@
 #define AnalysisVariable_h
 
 #include <string>
+#include "MicroTreeView.hxx"
 
 namespace TPCECalSystematics
 {
@@ -17,9 +18,13 @@ public:
       \param description   A descriptive phrase for the analysis variable. This
                            is used as the title for the analysis variable's plot
                            axis.
+      \param accessor   The microtree variable compiled as native code, or
+                        NULL to only use the string. EfficiencyEngine uses it
+                        in place of the string when it is given.
    */
    AnalysisVariable(const std::string& microtreeVariable,
-      const std::string& name="", const std::string& description="");
+      const std::string& name="", const std::string& description="",
+      MicroTreeAccessor accessor = nullptr);
 
    /**
       Copies the given AnalysisVariable object.
@@ -62,10 +67,18 @@ public:
    */   
    const std::string& GetDescription() const;
 
+   /**
+      Returns the compiled microtree variable.
+
+      \return The compiled variable, or NULL if there is none.
+   */   
+   MicroTreeAccessor GetAccessor() const;
+
 private:
    std::string _microtreeVariable;
    std::string _name;
    std::string _description;
+   MicroTreeAccessor _accessor;
 };
 }
 
@@ -0,0 +1,270 @@
+#ifndef CandidateSet_h
+#define CandidateSet_h
+
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/**
+   A contiguous set of selection candidates.
+
+   Candidates are stored in the order in which they are added. Cuts reject a
+   candidate by clearing its survivor flag rather than removing it, so Clear()
+   is O(1). The set starts with room for Capacity candidates and keeps its
+   storage when it is cleared, so memory is only allocated while a toy is
+   processed when an event has more candidates than any before it.
+
+   No candidate is ever dropped. Holding more than Capacity candidates is
+   counted, see GetNumOverflows, and the first time it happens to any set of
+   the type a warning is printed, as it means Capacity is too small for the
+   data.
+*/
+template <class T, unsigned int Capacity>
+class CandidateSet
+{
+public:
+   CandidateSet(): _items(Capacity), _indices(Capacity), _selected(Capacity),
+      _n(0), _nSelected(0)
+   {
+   }
+
+   /**
+      Empties the set. The storage is kept for reuse.
+   */
+   void Clear()
+   {
+      _n = 0;
+      _nSelected = 0;
+   }
+
+   /**
+      Makes this set a copy of another. Only the slots in use are copied.
+
+      \param other   The set to copy.
+   */
+   void CopyFrom(const CandidateSet& other)
+   {
+      if(other._n > _items.size())
+      {
+         Reserve(other._items.size());
+      }
+      for(unsigned int i = 0; i < other._n; ++i)
+      {
+         _items[i] = other._items[i];
+         _indices[i] = other._indices[i];
+         _selected[i] = other._selected[i];
+      }
+      _n = other._n;
+      _nSelected = other._nSelected;
+   }
+
+   /**
+      Adds a candidate to the end of the set.
+
+      \param item The candidate to add.
+      \param index   An optional index stored alongside the candidate, e.g. the
+                     row holding the candidate in a per-event cache.
+   */
+   void Add(const T& item, const int index = -1)
+   {
+      if(_n == _items.size())
+      {
+         Reserve(2 * _items.size());
+      }
+      if(_n == Capacity)
+      {
+         Overflow();
+      }
+      _items[_n] = item;
+      _indices[_n] = index;
+      _selected[_n] = true;
+      ++_n;
+      ++_nSelected;
+   }
+
+   /**
+      Rejects the candidate in the given slot.
+
+      \param i The slot of the candidate to reject.
+   */
+   void Reject(const unsigned int i)
+   {
+      assert(i < _n);
+      if(_selected[i])
+      {
+         _selected[i] = false;
+         --_nSelected;
+      }
+   }
+
+   /**
+      Rejects every candidate except the one in the given slot.
+
+      \param i The slot of the candidate to keep.
+   */
+   void KeepOnly(const unsigned int i)
+   {
+      assert(i < _n);
+      for(unsigned int j = 0; j < _n; ++j)
+      {
+         _selected[j] = (j == i);
+      }
+      _nSelected = 1;
+   }
+
+   /**
+      Checks whether the candidate in the given slot has survived the cuts
+      applied so far.
+
+      \param i The slot to check.
+      \return  True if the candidate is still selected, False otherwise.
+   */
+   bool IsSelected(const unsigned int i) const
+   {
+      assert(i < _n);
+      return _selected[i];
+   }
+
+   /**
+      Accesses the candidate in the given slot, whether or not it is still
+      selected.
+
+      \param i The slot to access.
+      \return  The candidate in the slot.
+   */
+   const T& operator[](const unsigned int i) const
+   {
+      assert(i < _n);
+      return _items[i];
+   }
+
+   /**
+      Accesses the index stored alongside the candidate in the given slot.
+
+      \param i The slot to access.
+      \return  The index given when the candidate was added, or -1 if none was.
+   */
+   int GetIndex(const unsigned int i) const
+   {
+      assert(i < _n);
+      return _indices[i];
+   }
+
+   /**
+      Retrieves the number of slots in use, including those holding rejected
+      candidates. Loops over the set run from 0 to this value.
+
+      \return  The number of slots in use.
+   */
+   unsigned int GetNumEntries() const
+   {
+      return _n;
+   }
+
+   /**
+      Retrieves the number of candidates that are still selected.
+
+      \return  The number of selected candidates.
+   */
+   unsigned int GetNumSelected() const
+   {
+      return _nSelected;
+   }
+
+   /**
+      Retrieves the number of candidates the set is sized for. Sets can hold
+      more, but are not expected to.
+
+      \return  The capacity of the set.
+   */
+   static unsigned int GetCapacity()
+   {
+      return Capacity;
+   }
+
+   /**
+      Retrieves the number of times a set of this type has had more than
+      Capacity candidates added since it was last cleared.
+
+      \return  The number of times.
+   */
+   static unsigned long GetNumOverflows()
+   {
+      return _nOverflows;
+   }
+
+private:
+   /**
+      Grows the storage of the set, keeping the candidates in it.
+
+      \param size The number of candidates to make room for.
+   */
+   void Reserve(const unsigned int size)
+   {
+      _items.resize(size);
+      _indices.resize(size);
+      _selected.resize(size);
+   }
+
+   /// Counts a set going over Capacity, warning the first time
+   static void Overflow()
+   {
+      if(_nOverflows++ == 0)
+      {
+         std::cerr << "CandidateSet: more than " << Capacity << " candidates "
+            "in an event. No candidate is lost, but the set has to grow, so "
+            "its capacity should be raised." << std::endl;
+      }
+   }
+
+   std::vector<T> _items;
+   std::vector<int> _indices;
+   /// Not std::vector<bool>, so a flag is a plain byte
+   std::vector<char> _selected;
+   unsigned int _n;
+   unsigned int _nSelected;
+
+   static unsigned long _nOverflows;
+};
+
+template <class T, unsigned int Capacity>
+unsigned long CandidateSet<T, Capacity>::_nOverflows = 0;
+
+/**
+   A working array of the batch kernels, e.g. of the rows of the selected
+   candidates of a set. It grows to the largest size asked for and is then
+   reused, so the kernels allocate nothing once the largest event has been
+   seen. Its contents are not kept when it grows.
+*/
+template <class T>
+class ScratchBuffer
+{
+public:
+   ScratchBuffer(): _size(0)
+   {
+   }
+
+   /**
+      Gets the buffer, growing it if needed.
+
+      \param n The number of elements needed.
+      \return  The buffer, of at least n elements.
+   */
+   T* Get(const unsigned int n)
+   {
+      if(n > _size)
+      {
+         _data.reset(new T[n]);
+         _size = n;
+      }
+
+      return _data.get();
+   }
+
+private:
+   std::unique_ptr<T[]> _data;
+   unsigned int _size;
+};
+
+#endif
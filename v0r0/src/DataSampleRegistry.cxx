@@ -0,0 +1,58 @@
+#include "DataSampleRegistry.hxx"
+#include "TBranch.h"
+#include "TTree.h"
+
+DataSampleRegistry::DataSampleRegistry(
+   const std::vector<std::string>& warmBranches): _warmBranches(warmBranches)
+{
+}
+
+DataSampleRegistry::~DataSampleRegistry()
+{
+   std::map<std::string, DataSample*>::iterator it;
+   for(it = _samples.begin(); it != _samples.end(); ++it)
+   {
+      delete it->second;
+   }
+}
+
+DataSample* DataSampleRegistry::Get(const std::string& filename)
+{
+   std::map<std::string, DataSample*>::iterator it = _samples.find(filename);
+   if(it != _samples.end())
+   {
+      return it->second;
+   }
+
+   DataSample* data = new DataSample(filename.c_str());
+   if(data->GetTree()->GetEntries() == 0)
+   {
+      delete data;
+      return nullptr;
+   }
+
+   _samples[filename] = data;
+
+   return data;
+}
+
+void DataSampleRegistry::Warm(DataSample& data)
+{
+   if(!_warmed.insert(&data).second)
+   {
+      return;
+   }
+
+   // A chain holds its baskets in the tree of its current file
+   TTree* chain = data.GetTree();
+   chain->LoadTree(0);
+   TTree* tree = chain->GetTree();
+   for(unsigned int i = 0; i < _warmBranches.size(); ++i)
+   {
+      TBranch* branch = tree->GetBranch(_warmBranches[i].c_str());
+      if(branch)
+      {
+         branch->LoadBaskets();
+      }
+   }
+}
@@ -0,0 +1,58 @@
+#ifndef DataSampleRegistry_h
+#define DataSampleRegistry_h
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "DataSample.hxx"
+
+/**
+   Opens the micro-tree of each file once and keeps it for the life of the
+   registry, handing out the same DataSample to everything that asks for the
+   file.
+
+   Warming a sample reads the baskets of the warmed branches into memory, so
+   every later pass over them, by TTree::Draw or an EfficiencyEngine, reads
+   memory rather than the file. A sample is only warmed when it is about to be
+   read, so a sample whose efficiencies are all cached is never read.
+*/
+class DataSampleRegistry
+{
+public:
+   /**
+      \param warmBranches  The branches to read into memory when a sample is
+                           warmed. Branches a file lacks are skipped.
+   */
+   DataSampleRegistry(const std::vector<std::string>& warmBranches =
+      std::vector<std::string>());
+   virtual ~DataSampleRegistry();
+
+   /**
+      Gets the sample of a file, opening it the first time.
+
+      \param filename   The file.
+      \return  The sample, owned by the registry, or NULL if its tree has no
+               entries.
+   */
+   DataSample* Get(const std::string& filename);
+
+   /**
+      Reads the baskets of the warmed branches of a sample into memory, the
+      first time it is called for the sample. Call it before reading the tree
+      of the sample.
+
+      \param data The sample, from Get.
+   */
+   void Warm(DataSample& data);
+
+private:
+   DataSampleRegistry(const DataSampleRegistry&);
+   DataSampleRegistry& operator=(const DataSampleRegistry&);
+
+   std::vector<std::string> _warmBranches;
+   std::map<std::string, DataSample*> _samples;
+   std::set<DataSample*> _warmed;
+};
+
+#endif
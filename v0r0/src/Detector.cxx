@@ -4,14 +4,18 @@ namespace TPCECalSystematics
 {
 
 Detector::Detector(const std::string& name, const std::string& description,
-   const std::string& signal, const std::string& cut):
-   _name(name), _description(description), _signal(signal), _cut(cut)
+   const std::string& signal, const std::string& cut,
+   MicroTreePredicate signalPredicate, MicroTreePredicate cutPredicate):
+   _name(name), _description(description), _signal(signal), _cut(cut),
+   _signalPredicate(signalPredicate), _cutPredicate(cutPredicate)
 {
 }
 
 Detector::Detector(const Detector& detector):
    _name(detector._name), _description(detector._description),
-   _signal(detector._signal), _cut(detector._cut)
+   _signal(detector._signal), _cut(detector._cut),
+   _signalPredicate(detector._signalPredicate),
+   _cutPredicate(detector._cutPredicate)
 {
 }
 
@@ -21,6 +25,8 @@ Detector& Detector::operator=(const Detector& detector)
    _description = detector._description;
    _signal = detector._signal;
    _cut = detector._cut;
+   _signalPredicate = detector._signalPredicate;
+   _cutPredicate = detector._cutPredicate;
 
    return *this;
 }
@@ -49,4 +55,14 @@ const std::string& Detector::GetCut() const
    return _cut;
 }
 
+MicroTreePredicate Detector::GetSignalPredicate() const
+{
+   return _signalPredicate;
+}
+
+MicroTreePredicate Detector::GetCutPredicate() const
+{
+   return _cutPredicate;
+}
+
 }
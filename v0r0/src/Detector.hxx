@@ -2,6 +2,7 @@
 #define Detector_h
 
 #include <string>
+#include "MicroTreeView.hxx"
 
 namespace TPCECalSystematics
 {
@@ -22,9 +23,17 @@ public:
       \param cut
          The microtree condition indicating that a track was reconstructed with
          the relevant detector segment (e.g. "ecalDetector==6").
+      \param signalPredicate
+         The signal compiled as native code, or NULL to only use the string.
+      \param cutPredicate
+         The cut compiled as native code, or NULL to only use the string.
+         EfficiencyEngine uses the predicates in place of the strings when
+         both are given, so they must agree with them.
    */
    Detector(const std::string& name, const std::string& description,
-      const std::string& signal, const std::string& cut);
+      const std::string& signal, const std::string& cut,
+      MicroTreePredicate signalPredicate = nullptr,
+      MicroTreePredicate cutPredicate = nullptr);
 
    /**
       Copies the given Detector object.
@@ -73,11 +82,27 @@ public:
    */   
    const std::string& GetCut() const;
 
+   /**
+      Returns the compiled signal associated with the detector.
+
+      \return The compiled signal, or NULL if there is none.
+   */   
+   MicroTreePredicate GetSignalPredicate() const;
+
+   /**
+      Returns the compiled cut associated with the detector.
+
+      \return The compiled cut, or NULL if there is none.
+   */   
+   MicroTreePredicate GetCutPredicate() const;
+
 private:
    std::string _name;
    std::string _description;
    std::string _signal;
    std::string _cut;
+   MicroTreePredicate _signalPredicate;
+   MicroTreePredicate _cutPredicate;
 };
 }
 
@@ -44,6 +44,7 @@ DrawingToolsTPCECal::DrawingToolsTPCECal(const std::string& file,
    _range = false;
    _multigraph = nullptr;
    _histogram1 = nullptr;
+   _efficiencyCache = nullptr;
 }
 
 DrawingToolsTPCECal::DrawingToolsTPCECal(Experiment& exp, bool useT2Kstyle):
@@ -53,6 +54,7 @@ DrawingToolsTPCECal::DrawingToolsTPCECal(Experiment& exp, bool useT2Kstyle):
    _range = false;
    _multigraph = nullptr;
    _histogram1 = nullptr;
+   _efficiencyCache = nullptr;
 }
 
 DrawingToolsTPCECal::~DrawingToolsTPCECal()
@@ -67,6 +69,60 @@ DrawingToolsTPCECal::~DrawingToolsTPCECal()
    }
 }
 
+void DrawingToolsTPCECal::AddEfficiencyEngine(EfficiencyEngine* engine)
+{
+   _efficiencyEngines.push_back(engine);
+}
+
+bool DrawingToolsTPCECal::IsEfficiencyCached(DataSample& data,
+   const std::string& variable, const std::string& signal,
+   const std::string& cut, int numBins, double* bins)
+{
+   return _efficiencyCache &&
+      _efficiencyCache->Contains(data, variable, signal, cut, numBins, bins);
+}
+
+void DrawingToolsTPCECal::GetEfficiencyHistos(DataSample& data,
+   const std::string& variable, const std::string& signal,
+   const std::string& cut, int numBins, double* bins, TH1F*& selec,
+   TH1F*& total)
+{
+   if(_efficiencyCache && _efficiencyCache->Get(data, variable, signal, cut,
+      numBins, bins, selec, total))
+   {
+      return;
+   }
+
+   selec = nullptr;
+   total = nullptr;
+   for(unsigned int i = 0; i < _efficiencyEngines.size() && !selec; ++i)
+   {
+      const EfficiencyEngine& engine = *_efficiencyEngines[i];
+      int request = engine.Find(variable, signal, cut, numBins, bins);
+      if(engine.GetTree() == data.GetTree() && engine.IsFilled() &&
+         request >= 0)
+      {
+         selec = static_cast<TH1F*>(engine.GetSelected(request).Clone());
+         total = static_cast<TH1F*>(engine.GetTotal(request).Clone());
+      }
+   }
+
+   if(!selec)
+   {
+      string sel = cut + " && " + signal;
+      selec = DrawingToolsBase::GetHisto(data.GetTree(), "selec", variable,
+         numBins, bins, sel, "", "", 1);
+      total = DrawingToolsBase::GetHisto(data.GetTree(), "total", variable,
+         numBins, bins, signal, "", "", 1);
+   }
+
+   if(_efficiencyCache)
+   {
+      _efficiencyCache->Store(data, variable, signal, cut, numBins, bins,
+         *selec, *total);
+   }
+}
+
 TGraphAsymmErrors* DrawingToolsTPCECal::CreateEfficiencyGraph(DataSample& data,
    const std::string& variable, const std::string& signal,
    const std::string& cut, int n, double* bins)
@@ -185,12 +241,11 @@ std::vector<double> DrawingToolsTPCECal::GetEfficiency(DataSample& data,
    }
 
    std::vector<double> efficiencies(numBins);
-   string sel = cut + " && " + signal;
 
-   TH1F* selec = DrawingToolsBase::GetHisto(data.GetTree(), "selec", variable,
-      numBins, bins, sel, "", "", 1);
-   TH1F* total = DrawingToolsBase::GetHisto(data.GetTree(), "total", variable,
-      numBins, bins, signal, "", "", 1);
+   TH1F* selec = nullptr;
+   TH1F* total = nullptr;
+   GetEfficiencyHistos(data, variable, signal, cut, numBins, bins, selec,
+      total);
 
    for(int i = 1; i < numBins + 1; i++)
    {
@@ -257,16 +312,15 @@ std::vector<double> DrawingToolsTPCECal::GetEfficiency(DataSample& data1,
    }
 
    std::vector<double> efficiencies(numBins);
-   string sel = cut + " && " + signal;
-
-   TH1F* selec1 = DrawingToolsBase::GetHisto(data1.GetTree(), "selec", variable,
-      numBins, bins, sel, "", "", 1);
-   TH1F* total1 = DrawingToolsBase::GetHisto(data1.GetTree(), "total", variable,
-      numBins, bins, signal, "", "", 1);
-   TH1F* selec2 = DrawingToolsBase::GetHisto(data2.GetTree(), "selec", variable,
-      numBins, bins, sel, "", "", 1);
-   TH1F* total2 = DrawingToolsBase::GetHisto(data2.GetTree(), "total", variable,
-      numBins, bins, signal, "", "", 1);
+
+   TH1F* selec1 = nullptr;
+   TH1F* total1 = nullptr;
+   GetEfficiencyHistos(data1, variable, signal, cut, numBins, bins, selec1,
+      total1);
+   TH1F* selec2 = nullptr;
+   TH1F* total2 = nullptr;
+   GetEfficiencyHistos(data2, variable, signal, cut, numBins, bins, selec2,
+      total2);
 
    selec1->Sumw2();
    selec2->Sumw2();
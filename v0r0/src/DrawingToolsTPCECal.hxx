@@ -2,6 +2,8 @@
 #define DrawingToolsTPCECal_h
 
 #include "DrawingTools.hxx"
+#include "EfficiencyEngine.hxx"
+#include "EfficiencyCache.hxx"
 #include "TMultiGraph.h"
 #include "TGraphAsymmErrors.h"
 
@@ -163,6 +165,41 @@ public:
       TGraphAsymmErrors& mcpGraph, const std::string& options,
       const std::vector<std::string>& legend);
 
+   /**
+      Adds an engine whose filled histograms are used by GetEfficiency, in
+      place of drawing them from its tree. Efficiencies that were not
+      requested of the engine are still drawn.
+
+      \param engine  The engine. This is not owned by the
+                     DrawingToolsTPCECal, so can be shared.
+   */
+   void AddEfficiencyEngine(EfficiencyEngine* engine);
+
+   /**
+      Sets the cache that GetEfficiency takes efficiencies from, before
+      trying the engines or the tree, and stores the efficiencies it finds
+      otherwise in.
+
+      \param cache   The cache, or NULL for none. This is not owned by the
+                     DrawingToolsTPCECal, so can be shared.
+   */
+   void SetEfficiencyCache(EfficiencyCache* cache){ _efficiencyCache = cache; }
+
+   /**
+      Checks whether the cache has an efficiency.
+
+      \param data The data sample.
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \return  True if it has, False otherwise or if there is no cache.
+   */
+   bool IsEfficiencyCached(DataSample& data, const std::string& variable,
+      const std::string& signal, const std::string& cut, int numBins,
+      double* bins);
+
    void SetTitleZ(const std::string& titleZ){ _titleZ=titleZ; }
    void SetMin(double min){ _min = min; }
    void SetMax(double max){ _max = max; }
@@ -207,12 +244,32 @@ protected:
       DataSample& antidata, const std::string& variable,
       const std::string& signal, const std::string& cut, int n, double* bins);
 
+   /**
+      Gets the selected and total histograms of a 1D efficiency, from the
+      cache or an efficiency engine if one has them, otherwise by drawing
+      them.
+
+      \param data The data sample.
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \param selec   Set to the histogram where the cut and signal are true.
+      \param total   Set to the histogram where the signal is true.
+   */
+   void GetEfficiencyHistos(DataSample& data, const std::string& variable,
+      const std::string& signal, const std::string& cut, int numBins,
+      double* bins, TH1F*& selec, TH1F*& total);
+
    std::string _titleZ;
    bool _range;
    double _min;
    double _max;
    TMultiGraph* _multigraph;
    TH1F* _histogram1;
+   std::vector<EfficiencyEngine*> _efficiencyEngines; //!
+   EfficiencyCache* _efficiencyCache; //!
 };
 
 #endif
@@ -0,0 +1,374 @@
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "EfficiencyCache.hxx"
+#include "TChain.h"
+#include "TFile.h"
+#include "TList.h"
+#include "TMD5.h"
+#include "TTree.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+EfficiencyCache::EfficiencyCache(const std::string& filename,
+   const std::string& salt): _filename(filename), _salt(salt),
+   _hashFilename(filename + ".hashes")
+{
+   Load();
+   LoadContentHashes();
+}
+
+EfficiencyCache::~EfficiencyCache()
+{
+}
+
+void EfficiencyCache::Load()
+{
+   std::ifstream file(_filename.c_str());
+   std::string line;
+   unsigned int numLines = 0;
+   while(std::getline(file, line))
+   {
+      ++numLines;
+      std::istringstream fields(line);
+      std::string key;
+      int numBins = 0;
+      if(!(fields >> key >> numBins) || numBins <= 0)
+      {
+         continue;
+      }
+
+      Entry entry;
+      entry.Selected.resize(numBins);
+      entry.SelectedErrors.resize(numBins);
+      entry.Total.resize(numBins);
+      entry.TotalErrors.resize(numBins);
+      for(int i = 0; i < numBins; ++i)
+      {
+         fields >> entry.Selected[i] >> entry.SelectedErrors[i] >>
+            entry.Total[i] >> entry.TotalErrors[i];
+      }
+
+      // A line cut short by a process that was killed while writing it
+      if(fields)
+      {
+         _entries[key] = entry;
+      }
+   }
+   file.close();
+
+   // Only the last line of each key is kept
+   if(numLines > _entries.size())
+   {
+      std::string contents;
+      for(std::map<std::string, Entry>::const_iterator it = _entries.begin();
+         it != _entries.end(); ++it)
+      {
+         contents += GetLine(it->first, it->second);
+      }
+      Rewrite(_filename, contents);
+   }
+}
+
+void EfficiencyCache::LoadContentHashes()
+{
+   std::ifstream file(_hashFilename.c_str());
+   std::string line;
+   unsigned int numLines = 0;
+   while(std::getline(file, line))
+   {
+      ++numLines;
+      // The filename is the rest of the line, as it may hold spaces
+      std::istringstream fields(line);
+      ContentHash hash;
+      std::string filename;
+      if(fields >> hash.Hash >> hash.Size >> hash.ModificationTime &&
+         fields.get() == ' ' && std::getline(fields, filename) &&
+         !filename.empty())
+      {
+         _contentHashes[filename] = hash;
+      }
+   }
+   file.close();
+
+   // Only the last checksum of each file that still exists is kept
+   struct stat status;
+   std::map<std::string, ContentHash>::iterator it = _contentHashes.begin();
+   while(it != _contentHashes.end())
+   {
+      if(stat(it->first.c_str(), &status) == 0)
+      {
+         ++it;
+      }
+      else
+      {
+         _contentHashes.erase(it++);
+      }
+   }
+   if(numLines > _contentHashes.size())
+   {
+      std::string contents;
+      for(it = _contentHashes.begin(); it != _contentHashes.end(); ++it)
+      {
+         contents += GetHashLine(it->first, it->second);
+      }
+      Rewrite(_hashFilename, contents);
+   }
+}
+
+std::string EfficiencyCache::GetLine(const std::string& key,
+   const Entry& entry)
+{
+   std::ostringstream line;
+   line << std::setprecision(17) << key << " " << entry.Selected.size();
+   for(unsigned int i = 0; i < entry.Selected.size(); ++i)
+   {
+      line << " " << entry.Selected[i] << " " << entry.SelectedErrors[i] <<
+         " " << entry.Total[i] << " " << entry.TotalErrors[i];
+   }
+   line << "\n";
+
+   return line.str();
+}
+
+std::string EfficiencyCache::GetHashLine(const std::string& filename,
+   const ContentHash& hash)
+{
+   std::ostringstream line;
+   line << hash.Hash << " " << hash.Size << " " << hash.ModificationTime <<
+      " " << filename << "\n";
+
+   return line.str();
+}
+
+void EfficiencyCache::Rewrite(const std::string& filename,
+   const std::string& contents)
+{
+   // Written to a file of this process and renamed over the old one, so
+   // another process never reads half of it
+   std::ostringstream temporary;
+   temporary << filename << "." << getpid();
+   std::ofstream file(temporary.str().c_str());
+   file << contents << std::flush;
+   file.close();
+   if(!file || std::rename(temporary.str().c_str(), filename.c_str()) != 0)
+   {
+      std::cerr << "EfficiencyCache: could not compact " << filename <<
+         std::endl;
+      std::remove(temporary.str().c_str());
+   }
+}
+
+const std::string& EfficiencyCache::GetContentHash(
+   const std::string& filename)
+{
+   // A file that could not be read has an empty checksum, with the size and
+   // modification time -1, and is not read again
+   struct stat status;
+   const bool found = stat(filename.c_str(), &status) == 0;
+   const long long size = found ? status.st_size : -1;
+   const long long modificationTime = found ? status.st_mtime : -1;
+   std::map<std::string, ContentHash>::iterator it =
+      _contentHashes.find(filename);
+   if(it != _contentHashes.end() && it->second.Size == size &&
+      it->second.ModificationTime == modificationTime)
+   {
+      return it->second.Hash;
+   }
+
+   ContentHash& hash = _contentHashes[filename];
+   hash.Hash.clear();
+   hash.Size = -1;
+   hash.ModificationTime = -1;
+   TMD5* checksum = found ? TMD5::FileChecksum(filename.c_str()) : nullptr;
+   if(!checksum)
+   {
+      std::cerr << "EfficiencyCache: could not read " << filename <<
+         ", so its efficiencies are not cached" << std::endl;
+      return hash.Hash;
+   }
+   hash.Hash = checksum->AsString();
+   hash.Size = size;
+   hash.ModificationTime = modificationTime;
+   delete checksum;
+
+   // A file modified in the current second could change again without its
+   // modification time changing, so its checksum is only kept in memory
+   if(status.st_mtime >= std::time(0))
+   {
+      return hash.Hash;
+   }
+
+   // Appended in one go, as the cache file is
+   std::ofstream file(_hashFilename.c_str(), std::ios::app);
+   file << GetHashLine(filename, hash) << std::flush;
+   if(!file)
+   {
+      std::cerr << "EfficiencyCache: could not write to " << _hashFilename <<
+         std::endl;
+   }
+
+   return hash.Hash;
+}
+
+std::string EfficiencyCache::GetKey(DataSample& data,
+   const std::string& variable, const std::string& signal,
+   const std::string& cut, const int numBins, const double* bins)
+{
+   TTree* tree = data.GetTree();
+   std::vector<std::string> files;
+   TChain* chain = dynamic_cast<TChain*>(tree);
+   if(chain)
+   {
+      TIter next(chain->GetListOfFiles());
+      while(TObject* element = next())
+      {
+         files.push_back(element->GetTitle());
+      }
+   }
+   else if(tree->GetCurrentFile())
+   {
+      files.push_back(tree->GetCurrentFile()->GetName());
+   }
+
+   std::ostringstream key;
+   key << std::setprecision(17) << Version << "\n" << _salt << "\n";
+   for(unsigned int f = 0; f < files.size(); ++f)
+   {
+      const std::string& hash = GetContentHash(files[f]);
+      if(hash.empty())
+      {
+         return "";
+      }
+      key << hash << "\n";
+   }
+   if(files.empty())
+   {
+      return "";
+   }
+
+   // The expressions may use aliases, such as those UseSelection sets, whose
+   // meaning depends on the selection
+   if(tree->GetListOfAliases())
+   {
+      TIter next(tree->GetListOfAliases());
+      while(TObject* alias = next())
+      {
+         key << alias->GetName() << "=" << alias->GetTitle() << "\n";
+      }
+   }
+
+   key << variable << "\n" << signal << "\n" << cut << "\n";
+   for(int i = 0; i <= numBins; ++i)
+   {
+      key << bins[i] << " ";
+   }
+
+   const std::string text = key.str();
+   TMD5 md5;
+   md5.Update(reinterpret_cast<const UChar_t*>(text.data()), text.size());
+   md5.Final();
+
+   return md5.AsString();
+}
+
+bool EfficiencyCache::Contains(DataSample& data, const std::string& variable,
+   const std::string& signal, const std::string& cut, const int numBins,
+   const double* bins)
+{
+   const std::string key = GetKey(data, variable, signal, cut, numBins, bins);
+   return !key.empty() && _entries.count(key);
+}
+
+/**
+   Creates a histogram with the given bin contents and errors. The errors are
+   only set if they are not those of unweighted entries, so the histogram
+   has no sum of squares of weights unless the original did.
+
+   \param name The name of the histogram.
+   \param numBins The number of bins.
+   \param bins   The bin boundaries.
+   \param contents   The contents of the bins.
+   \param errors  The errors of the bins.
+   \return  The histogram.
+*/
+static TH1F* CreateHisto(const char* name, const int numBins,
+   const double* bins, const std::vector<double>& contents,
+   const std::vector<double>& errors)
+{
+   TH1F* histogram = new TH1F(name, "", numBins, bins);
+   histogram->SetDirectory(0);
+   bool weighted = false;
+   double entries = 0;
+   for(int i = 0; i < numBins; ++i)
+   {
+      histogram->SetBinContent(i + 1, contents[i]);
+      weighted = weighted || errors[i] != std::sqrt(contents[i]);
+      entries += contents[i];
+   }
+   if(weighted)
+   {
+      for(int i = 0; i < numBins; ++i)
+      {
+         histogram->SetBinError(i + 1, errors[i]);
+      }
+   }
+   histogram->SetEntries(entries);
+
+   return histogram;
+}
+
+bool EfficiencyCache::Get(DataSample& data, const std::string& variable,
+   const std::string& signal, const std::string& cut, const int numBins,
+   const double* bins, TH1F*& selec, TH1F*& total)
+{
+   const std::string key = GetKey(data, variable, signal, cut, numBins, bins);
+   std::map<std::string, Entry>::const_iterator it = _entries.find(key);
+   if(key.empty() || it == _entries.end() ||
+      it->second.Selected.size() != static_cast<unsigned int>(numBins))
+   {
+      return false;
+   }
+
+   const Entry& entry = it->second;
+   selec = CreateHisto("selec", numBins, bins, entry.Selected,
+      entry.SelectedErrors);
+   total = CreateHisto("total", numBins, bins, entry.Total, entry.TotalErrors);
+
+   return true;
+}
+
+void EfficiencyCache::Store(DataSample& data, const std::string& variable,
+   const std::string& signal, const std::string& cut, const int numBins,
+   const double* bins, const TH1F& selec, const TH1F& total)
+{
+   const std::string key = GetKey(data, variable, signal, cut, numBins, bins);
+   if(key.empty())
+   {
+      return;
+   }
+
+   Entry entry;
+   for(int i = 1; i <= numBins; ++i)
+   {
+      entry.Selected.push_back(selec.GetBinContent(i));
+      entry.SelectedErrors.push_back(selec.GetBinError(i));
+      entry.Total.push_back(total.GetBinContent(i));
+      entry.TotalErrors.push_back(total.GetBinError(i));
+   }
+   _entries[key] = entry;
+
+   // The line is written in one go, so that lines appended by other
+   // processes are not interleaved with it
+   std::ofstream file(_filename.c_str(), std::ios::app);
+   file << GetLine(key, entry) << std::flush;
+   if(!file)
+   {
+      std::cerr << "EfficiencyCache: could not write to " << _filename <<
+         std::endl;
+   }
+}
@@ -0,0 +1,188 @@
+#ifndef EfficiencyCache_h
+#define EfficiencyCache_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include "DataSample.hxx"
+#include "TH1F.h"
+
+/**
+   Keeps the selected and total histograms of 1D efficiencies in a text file,
+   so that later runs get them without reading the micro-trees.
+
+   An efficiency is keyed by the MD5 checksum of the contents of each file of
+   the sample, the aliases of its tree, the variable, signal, cut and bin
+   boundaries, the version of the cache and a salt given by the application.
+   The value is the content and error of each bin of both histograms.
+   Changing an input file changes its checksum, so the efficiencies of the old
+   file are never found again.
+
+   The key does not cover the code that fills the efficiencies, such as the
+   compiled signals and cuts of an EfficiencyEngine. The application passes a
+   salt that it changes whenever that code of its own changes, and Version is
+   to be increased when the filling code of this package changes.
+
+   The checksum of each file is kept in a second file, the cache file with
+   .hashes appended, together with the size and modification time of the
+   file, so a later run only reads the files that changed since.
+
+   New efficiencies are appended to the file as they are stored, so several
+   processes can share it. Where the file has more than one line for a key,
+   the last is used. Loading the cache rewrites the file with only that line
+   of each key, and the file of checksums with only the last checksum of each
+   file that still exists. An efficiency appended by another process while
+   the file is rewritten may be lost, and is then found again by a later run.
+*/
+class EfficiencyCache
+{
+public:
+   /// The version of the cache, part of every key
+   static const int Version = 1;
+
+   /**
+      \param filename   The cache file, which is created if it does not exist.
+      \param salt   Part of every key, which changes with the code of the
+                     application that fills the efficiencies.
+   */
+   EfficiencyCache(const std::string& filename, const std::string& salt);
+   virtual ~EfficiencyCache();
+
+   /**
+      Checks whether an efficiency is in the cache.
+
+      \param data The data sample.
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \return  True if it is, False otherwise.
+   */
+   bool Contains(DataSample& data, const std::string& variable,
+      const std::string& signal, const std::string& cut, const int numBins,
+      const double* bins);
+
+   /**
+      Gets the histograms of an efficiency from the cache.
+
+      \param data The data sample.
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \param selec   Set to a new histogram where the cut and signal are true.
+      \param total   Set to a new histogram where the signal is true.
+      \return  True if the efficiency was in the cache, False otherwise.
+   */
+   bool Get(DataSample& data, const std::string& variable,
+      const std::string& signal, const std::string& cut, const int numBins,
+      const double* bins, TH1F*& selec, TH1F*& total);
+
+   /**
+      Stores the histograms of an efficiency, in memory and in the file.
+
+      \param data The data sample.
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \param selec   The histogram where the cut and signal are true.
+      \param total   The histogram where the signal is true.
+   */
+   void Store(DataSample& data, const std::string& variable,
+      const std::string& signal, const std::string& cut, const int numBins,
+      const double* bins, const TH1F& selec, const TH1F& total);
+
+private:
+   EfficiencyCache(const EfficiencyCache&);
+   EfficiencyCache& operator=(const EfficiencyCache&);
+
+   /// The bin contents and errors of the histograms of one efficiency
+   struct Entry
+   {
+      std::vector<double> Selected;
+      std::vector<double> SelectedErrors;
+      std::vector<double> Total;
+      std::vector<double> TotalErrors;
+   };
+
+   /// The checksum of the contents of a file, and the size and modification
+   /// time of the file it was computed for
+   struct ContentHash
+   {
+      std::string Hash;
+      long long Size;
+      long long ModificationTime;
+   };
+
+   /// Reads the entries of the file
+   void Load();
+
+   /// Reads the checksums of the file of checksums
+   void LoadContentHashes();
+
+   /**
+      Gets the line of the file that holds an efficiency.
+
+      \param key  The key of the efficiency.
+      \param entry   The histograms of the efficiency.
+      \return  The line, with its newline.
+   */
+   static std::string GetLine(const std::string& key, const Entry& entry);
+
+   /**
+      Gets the line of the file of checksums that holds the checksum of a
+      file.
+
+      \param filename   The file.
+      \param hash The checksum.
+      \return  The line, with its newline.
+   */
+   static std::string GetHashLine(const std::string& filename,
+      const ContentHash& hash);
+
+   /**
+      Replaces the contents of a file.
+
+      \param filename   The file.
+      \param contents   The new contents.
+   */
+   static void Rewrite(const std::string& filename,
+      const std::string& contents);
+
+   /**
+      Gets the key of an efficiency.
+
+      \param data The data sample.
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \return  The MD5 checksum of everything the efficiency depends on.
+   */
+   std::string GetKey(DataSample& data, const std::string& variable,
+      const std::string& signal, const std::string& cut, const int numBins,
+      const double* bins);
+
+   /**
+      Gets the checksum of the contents of a file. A file is only read if it
+      has changed since its checksum was last saved, and its new checksum is
+      then saved.
+
+      \param filename   The file.
+      \return  The MD5 checksum, or an empty string if the file is unreadable.
+   */
+   const std::string& GetContentHash(const std::string& filename);
+
+   std::string _filename;
+   std::string _salt;
+   std::map<std::string, Entry> _entries;
+   std::string _hashFilename;
+   std::map<std::string, ContentHash> _contentHashes;
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <iostream>
+#include "EfficiencyEngine.hxx"
+#include "TTree.h"
+#include "TTreeFormula.h"
+#include "TTreeFormulaManager.h"
+
+EfficiencyEngine::EfficiencyEngine(DataSample& data, const int selection):
+   _tree(data.GetTree()), _selection(selection), _filled(false)
+{
+}
+
+EfficiencyEngine::~EfficiencyEngine()
+{
+   DeleteFormulas();
+   for(unsigned int r = 0; r < _requests.size(); ++r)
+   {
+      delete _requests[r].Selected;
+      delete _requests[r].Total;
+   }
+}
+
+unsigned int EfficiencyEngine::Add(const std::string& variable,
+   const std::string& signal, const std::string& cut, const int numBins,
+   const double* bins)
+{
+   int existing = Find(variable, signal, cut, numBins, bins);
+   if(existing >= 0)
+   {
+      return existing;
+   }
+
+   Request request;
+   request.Variable = variable;
+   request.Signal = signal;
+   request.Cut = cut;
+   request.Bins.assign(bins, bins + numBins + 1);
+   request.Accessor = nullptr;
+   request.SignalPredicate = nullptr;
+   request.CutPredicate = nullptr;
+   request.Native = false;
+   request.Selected = new TH1F("selec", "", numBins, bins);
+   request.Selected->SetDirectory(0);
+   request.Total = new TH1F("total", "", numBins, bins);
+   request.Total->SetDirectory(0);
+   request.VariableFormula = nullptr;
+   request.TotalFormula = nullptr;
+   request.SelectedFormula = nullptr;
+   request.Manager = nullptr;
+   _requests.push_back(request);
+   _filled = false;
+
+   return _requests.size() - 1;
+}
+
+unsigned int EfficiencyEngine::Add(
+   const TPCECalSystematics::AnalysisVariable& variable,
+   const TPCECalSystematics::Detector& detector, const int numBins,
+   const double* bins)
+{
+   unsigned int index = Add(variable.GetMicrotreeVariable(),
+      detector.GetSignal(), detector.GetCut(), numBins, bins);
+   if(variable.GetAccessor() && detector.GetSignalPredicate() &&
+      detector.GetCutPredicate())
+   {
+      Request& request = _requests[index];
+      request.Accessor = variable.GetAccessor();
+      request.SignalPredicate = detector.GetSignalPredicate();
+      request.CutPredicate = detector.GetCutPredicate();
+   }
+
+   return index;
+}
+
+int EfficiencyEngine::Find(const std::string& variable,
+   const std::string& signal, const std::string& cut, const int numBins,
+   const double* bins) const
+{
+   for(unsigned int r = 0; r < _requests.size(); ++r)
+   {
+      const Request& request = _requests[r];
+      if(request.Variable == variable && request.Signal == signal &&
+         request.Cut == cut && request.Bins.size() == numBins + 1u &&
+         std::equal(request.Bins.begin(), request.Bins.end(), bins))
+      {
+         return r;
+      }
+   }
+
+   return -1;
+}
+
+bool EfficiencyEngine::Compile(Request& request)
+{
+   // The selections are those GetEfficiency gives TTree::Draw
+   const std::string selected = request.Cut + " && " + request.Signal;
+   request.VariableFormula = new TTreeFormula("variable",
+      request.Variable.c_str(), _tree);
+   request.TotalFormula = new TTreeFormula("total", request.Signal.c_str(),
+      _tree);
+   request.SelectedFormula = new TTreeFormula("selected", selected.c_str(),
+      _tree);
+   if(!request.VariableFormula->GetNdim() || !request.TotalFormula->GetNdim()
+      || !request.SelectedFormula->GetNdim())
+   {
+      std::cerr << "EfficiencyEngine: could not compile " << request.Variable <<
+         ", " << request.Signal << " or " << selected << std::endl;
+      return false;
+   }
+
+   request.Manager = new TTreeFormulaManager();
+   request.Manager->Add(request.VariableFormula);
+   request.Manager->Add(request.TotalFormula);
+   request.Manager->Add(request.SelectedFormula);
+   request.Manager->Sync();
+
+   return true;
+}
+
+void EfficiencyEngine::DeleteFormulas()
+{
+   // A manager is deleted with the last of its formulas
+   for(unsigned int r = 0; r < _requests.size(); ++r)
+   {
+      delete _requests[r].VariableFormula;
+      delete _requests[r].TotalFormula;
+      delete _requests[r].SelectedFormula;
+      _requests[r].VariableFormula = nullptr;
+      _requests[r].TotalFormula = nullptr;
+      _requests[r].SelectedFormula = nullptr;
+      _requests[r].Manager = nullptr;
+   }
+}
+
+/**
+   Evaluates an instance of a formula as TTree::Draw would, using the first
+   instance if the formula is not an array.
+
+   \param formula The formula.
+   \param instance   The instance.
+   \return  The value.
+*/
+static double Evaluate(TTreeFormula* formula, const int instance)
+{
+   return formula->EvalInstance(formula->GetMultiplicity() ? instance : 0);
+}
+
+bool EfficiencyEngine::Fill()
+{
+   _filled = false;
+
+   // The view is only needed, and its branches only read, if some request is
+   // compiled
+   MicroTreeView* view = nullptr;
+   for(unsigned int r = 0; r < _requests.size() && !view; ++r)
+   {
+      if(_requests[r].Accessor)
+      {
+         view = new MicroTreeView(_tree, _selection);
+      }
+   }
+   if(view && !view->IsValid())
+   {
+      std::cerr << "EfficiencyEngine: the micro-tree lacks a variable of the "
+         "compiled requests, so their expressions are used" << std::endl;
+      delete view;
+      view = nullptr;
+   }
+
+   // A chain must have a tree loaded to compile formulas against
+   _tree->LoadTree(0);
+   bool compiled = true;
+   for(unsigned int r = 0; r < _requests.size() && compiled; ++r)
+   {
+      Request& request = _requests[r];
+      request.Selected->Reset();
+      request.Total->Reset();
+      request.Native = view && request.Accessor;
+      if(!request.Native)
+      {
+         compiled = Compile(request);
+      }
+   }
+   if(!compiled)
+   {
+      DeleteFormulas();
+      delete view;
+      return false;
+   }
+
+   int treeNumber = -1;
+   const Long64_t nEntries = _tree->GetEntries();
+   for(Long64_t entry = 0; entry < nEntries; ++entry)
+   {
+      if(view ? !view->Read(entry) : _tree->LoadTree(entry) < 0)
+      {
+         break;
+      }
+
+      // The formulas must find their leaves again in each file of a chain
+      if(_tree->GetTreeNumber() != treeNumber)
+      {
+         treeNumber = _tree->GetTreeNumber();
+         for(unsigned int r = 0; r < _requests.size(); ++r)
+         {
+            if(_requests[r].Manager)
+            {
+               _requests[r].Manager->UpdateFormulaLeaves();
+            }
+         }
+      }
+
+      for(unsigned int r = 0; r < _requests.size(); ++r)
+      {
+         Request& request = _requests[r];
+         if(request.Native)
+         {
+            if(request.SignalPredicate(*view))
+            {
+               const double value = request.Accessor(*view);
+               request.Total->Fill(value);
+               if(request.CutPredicate(*view))
+               {
+                  request.Selected->Fill(value);
+               }
+            }
+            continue;
+         }
+
+         const int nData = request.Manager->GetNdata();
+         for(int i = 0; i < nData; ++i)
+         {
+            // Instance 0 of each formula is evaluated before any other, which
+            // loads its branches
+            const double total = Evaluate(request.TotalFormula, i);
+            const double selected = Evaluate(request.SelectedFormula, i);
+            const double value = Evaluate(request.VariableFormula, i);
+            if(total != 0)
+            {
+               request.Total->Fill(value, total);
+            }
+            if(selected != 0)
+            {
+               request.Selected->Fill(value, selected);
+            }
+         }
+      }
+   }
+
+   DeleteFormulas();
+   delete view;
+   _filled = true;
+
+   return true;
+}
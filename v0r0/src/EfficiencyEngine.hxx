@@ -0,0 +1,175 @@
+#ifndef EfficiencyEngine_h
+#define EfficiencyEngine_h
+
+#include <string>
+#include <vector>
+#include "DataSample.hxx"
+#include "Detector.hxx"
+#include "AnalysisVariable.hxx"
+#include "MicroTreeView.hxx"
+#include "TH1F.h"
+
+class TTreeFormula;
+class TTreeFormulaManager;
+
+/**
+   Fills the selected and total histograms of many efficiencies of a data
+   sample in a single pass over its micro-tree.
+
+   Each efficiency is requested as a variable, signal, cut and binning. The
+   histograms are those DrawingToolsTPCECal::GetEfficiency would draw: the
+   variable where signal is true, and where cut and signal are both true.
+   TTree::Draw reads the whole tree for each histogram, whereas Fill reads it
+   once and evaluates every request on each entry.
+
+   Requests whose variable, signal and cut are all compiled are evaluated as
+   native code on a MicroTreeView of the tree, rather than as TTreeFormulas.
+   The strings are still used to find the request, and are evaluated instead
+   if the tree lacks a variable of the view.
+*/
+class EfficiencyEngine
+{
+public:
+   /**
+      \param data The data sample. Any aliases used by the requests must be
+                  set on its tree before Fill is called.
+      \param selection  The index of the selection that compiled requests
+                        use, for micro-trees of every selection.
+   */
+   EfficiencyEngine(DataSample& data, const int selection = 0);
+   virtual ~EfficiencyEngine();
+
+   /**
+      Requests an efficiency. Requesting the same efficiency again returns
+      the earlier request.
+
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \return  The index of the request.
+   */
+   unsigned int Add(const std::string& variable, const std::string& signal,
+      const std::string& cut, const int numBins, const double* bins);
+
+   /**
+      Requests an efficiency of a variable and detector, using their compiled
+      forms if they both have them.
+
+      \param variable   The binning variable.
+      \param detector   The detector, giving the signal and cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \return  The index of the request.
+   */
+   unsigned int Add(const TPCECalSystematics::AnalysisVariable& variable,
+      const TPCECalSystematics::Detector& detector, const int numBins,
+      const double* bins);
+
+   /**
+      Fills the histograms of every request in one pass over the tree.
+
+      \return  True if the histograms were filled, False if an expression
+               could not be compiled.
+   */
+   bool Fill();
+
+   /**
+      Checks whether the histograms have been filled.
+
+      \return  True if Fill has succeeded, False otherwise.
+   */
+   bool IsFilled() const { return _filled; }
+
+   /**
+      Gets the number of requests.
+
+      \return  The number of requests.
+   */
+   unsigned int GetNumRequests() const { return _requests.size(); }
+
+   /**
+      Gets the tree that the engine reads.
+
+      \return  The tree.
+   */
+   TTree* GetTree() const { return _tree; }
+
+   /**
+      Finds a request.
+
+      \param variable   The binning variable.
+      \param signal  The signal.
+      \param cut  The cut.
+      \param numBins The number of bins.
+      \param bins   The bin boundaries.
+      \return  The index of the request, or -1 if it was not requested.
+   */
+   int Find(const std::string& variable, const std::string& signal,
+      const std::string& cut, const int numBins, const double* bins) const;
+
+   /**
+      Gets the histogram of a request where the cut and signal are true.
+
+      \param request The index of the request.
+      \return  The histogram, owned by the engine.
+   */
+   const TH1F& GetSelected(const unsigned int request) const
+   {
+      return *_requests[request].Selected;
+   }
+
+   /**
+      Gets the histogram of a request where the signal is true.
+
+      \param request The index of the request.
+      \return  The histogram, owned by the engine.
+   */
+   const TH1F& GetTotal(const unsigned int request) const
+   {
+      return *_requests[request].Total;
+   }
+
+private:
+   /// One requested efficiency
+   struct Request
+   {
+      std::string Variable;
+      std::string Signal;
+      std::string Cut;
+      std::vector<double> Bins;
+      /// The compiled variable, signal and cut, or NULL
+      MicroTreeAccessor Accessor;
+      MicroTreePredicate SignalPredicate;
+      MicroTreePredicate CutPredicate;
+      /// Whether the request is being evaluated as native code
+      bool Native;
+      TH1F* Selected;
+      TH1F* Total;
+      /// The variable, signal and cut && signal formulas, which share a
+      /// manager so they agree on the number of instances of each entry
+      TTreeFormula* VariableFormula;
+      TTreeFormula* TotalFormula;
+      TTreeFormula* SelectedFormula;
+      TTreeFormulaManager* Manager;
+   };
+
+   /**
+      Compiles the formulas of a request.
+
+      \param request The request.
+      \return  True if every formula compiled, False otherwise.
+   */
+   bool Compile(Request& request);
+
+   /// Deletes the formulas of every request
+   void DeleteFormulas();
+
+   TTree* _tree;
+   int _selection;
+   std::vector<Request> _requests;
+   bool _filled;
+};
+
+#endif
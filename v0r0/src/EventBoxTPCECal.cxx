@@ -0,0 +1,131 @@
+#include <cstdlib>
+#include <iostream>
+#include "EventBoxTPCECal.hxx"
+#include "EventBoxUtils.hxx"
+#include "TPCECalSelection.hxx"
+
+unsigned long EventBoxTPCECal::_nextSerial = 1;
+bool EventBoxTPCECal::_fillSystematicsGroups = true;
+
+EventBoxTPCECal::EventBoxTPCECal(): EventBoxTracker(),
+   _serial(_nextSerial++), _filled(false),
+   _filledDetectorFV(SubDetId::kInvalid), _filledGroups(0)
+{
+}
+
+EventBoxTPCECal::~EventBoxTPCECal()
+{
+   ClearMemos();
+}
+
+EventBoxTPCECal& EventBoxTPCECal::Create(AnaEventB& event)
+{
+   if(!event.EventBoxes[AnaEventB::kEventBoxTracker])
+   {
+      event.EventBoxes[AnaEventB::kEventBoxTracker] = new EventBoxTPCECal();
+   }
+
+   return Get(event);
+}
+
+EventBoxTPCECal& EventBoxTPCECal::Get(const AnaEventB& event)
+{
+   EventBoxTPCECal* eventBox = dynamic_cast<EventBoxTPCECal*>(
+      event.EventBoxes[AnaEventB::kEventBoxTracker]);
+   if(!eventBox)
+   {
+      std::cerr << "EventBoxTPCECal: the tracker EventBox of the event is " <<
+         (event.EventBoxes[AnaEventB::kEventBoxTracker] ? "of another type" :
+         "missing") << ". The TPC/ECal selections cannot be run with " <<
+         "selections that create their own." << std::endl;
+      exit(1);
+   }
+
+   return *eventBox;
+}
+
+void EventBoxTPCECal::Fill(AnaEventB& event, const SubDetId::SubDetEnum det)
+{
+   if(_filled && _filledDetectorFV == det)
+   {
+      return;
+   }
+
+   // The groups of another fiducial volume are refilled
+   _filledDetectorFV = det;
+   _filledGroups = 0;
+
+   unsigned int groups = kTPCGroups;
+   if(_fillSystematicsGroups && event.GetIsMC())
+   {
+      groups |= kFGDGroups | kTruthGroups;
+   }
+   FillGroups(event, groups);
+
+   // Cache the back TPC segments of the candidate tracks for all toys and
+   // selections
+   segments.Build(event, det);
+   ClearMemos();
+
+   _filled = true;
+}
+
+void EventBoxTPCECal::FillGroups(AnaEventB& event, const unsigned int groups)
+{
+   const unsigned int needed = groups & ~_filledGroups;
+   if(!needed)
+   {
+      return;
+   }
+
+   if(needed & kTPCGroups)
+   {
+      boxUtils::FillTracksWithTPC(event, _filledDetectorFV);
+   }
+   if(needed & kFGDGroups)
+   {
+      boxUtils::FillTracksWithFGD(event, _filledDetectorFV);
+   }
+   if((needed & kTruthGroups) && event.GetIsMC())
+   {
+      boxUtils::FillTrajsChargedInTPC(event);
+      boxUtils::FillTrajsChargedInFGDAndNoTPC(event, _filledDetectorFV);
+   }
+
+   _filledGroups |= needed;
+}
+
+const ToyBoxTPCECal* EventBoxTPCECal::FindMemo(const ULong64_t key,
+   bool& passed) const
+{
+   std::map<ULong64_t, Memo>::const_iterator it = _memos.find(key);
+   if(it == _memos.end())
+   {
+      return nullptr;
+   }
+
+   passed = it->second.Passed;
+   return it->second.Box;
+}
+
+void EventBoxTPCECal::AddMemo(const ULong64_t key, const bool passed,
+   const ToyBoxTPCECal& box)
+{
+   Memo& memo = _memos[key];
+   if(!memo.Box)
+   {
+      memo.Box = new ToyBoxTPCECal();
+   }
+   memo.Passed = passed;
+   memo.Box->CopyState(box);
+}
+
+void EventBoxTPCECal::ClearMemos()
+{
+   std::map<ULong64_t, Memo>::iterator it;
+   for(it = _memos.begin(); it != _memos.end(); ++it)
+   {
+      delete it->second.Box;
+   }
+   _memos.clear();
+}
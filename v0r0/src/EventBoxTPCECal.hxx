@@ -0,0 +1,155 @@
+#ifndef EventBoxTPCECal_h
+#define EventBoxTPCECal_h
+
+#include <map>
+#include "EventBoxTracker.hxx"
+#include "SubDetId.hxx"
+#include "TPCBackSegmentCache.hxx"
+
+class ToyBoxTPCECal;
+
+/**
+   The tracker EventBox of the TPC/ECal selections.
+
+   As well as the usual track groups, it holds the back TPC segment cache of
+   the event. Both are filled by the first selection to initialise the event
+   and then reused by every other selection, so the common preselection work is
+   done once per event however many selections are enabled.
+
+   Only the TPC track groups, which the segment cache is built from, are always
+   filled. The FGD track groups and the truth trajectory groups are only read by
+   the standard systematics and by a few cuts, so they are filled on MC when
+   the systematics need them, and otherwise when a cut first asks for them.
+   The truth groups are never filled for data, which has no trajectories.
+
+   It also holds the memo of the toy-invariant steps at the start of the
+   trunks (see StepMemo). Steps are recorded by the key of their
+   configuration and that of every step before them, so a selection whose
+   leading steps match those of a selection that has already seen the event
+   replays them.
+*/
+class EventBoxTPCECal: public EventBoxTracker
+{
+public:
+   /// Sets of track groups, each filled by boxUtils in one go
+   enum GroupSetEnum
+   {
+      kTPCGroups = 1 << 0,
+      kFGDGroups = 1 << 1,
+      kTruthGroups = 1 << 2
+   };
+
+   EventBoxTPCECal();
+   virtual ~EventBoxTPCECal();
+
+   /**
+      Retrieves the tracker EventBox of an event, creating it if the event has
+      none yet. This is for InitializeEvent. An EventBox of another type, e.g.
+      one created by a selection of another package, has no segment cache, so
+      the job is stopped.
+
+      \param event   The event.
+      \return  The EventBox.
+   */
+   static EventBoxTPCECal& Create(AnaEventB& event);
+
+   /**
+      Retrieves the tracker EventBox of an event, which InitializeEvent must
+      already have created. The job is stopped if the event has none or one of
+      another type.
+
+      \param event   The event.
+      \return  The EventBox.
+   */
+   static EventBoxTPCECal& Get(const AnaEventB& event);
+
+   /**
+      Sets whether the FGD and truth groups are filled with the TPC groups for
+      MC, as the standard systematics read them. This must be set before the
+      first event. TPCECalSystematicsAnalysis sets it from whether any enabled
+      configuration runs systematics or toys, otherwise they are filled.
+
+      \param fill Whether to fill them for every MC event.
+   */
+   static void SetFillSystematicsGroups(const bool fill)
+   {
+      _fillSystematicsGroups = fill;
+   }
+
+   /**
+      Fills the TPC track groups and builds the segment cache for an event,
+      unless this has already been done for the same detector fiducial volume.
+
+      \param event   The event that owns this EventBox.
+      \param det  The detector fiducial volume of the selection.
+   */
+   void Fill(AnaEventB& event, const SubDetId::SubDetEnum det);
+
+   /**
+      Fills any of some sets of groups that have not yet been filled for the
+      event, for the fiducial volume of the last Fill.
+
+      \param event   The event that owns this EventBox.
+      \param groups  The GroupSetEnum flags of the sets needed.
+   */
+   void FillGroups(AnaEventB& event, const unsigned int groups);
+
+   /**
+      Finds the recorded result of a memoised step.
+
+      \param key  The key of the step, from StepCheckpoint::GetStepKey.
+      \param passed Set to the result of the step, if it was recorded.
+      \return  The box as the step left it, or null if the step has not been
+               recorded for this event.
+   */
+   const ToyBoxTPCECal* FindMemo(const ULong64_t key, bool& passed) const;
+
+   /**
+      Records the result of a memoised step.
+
+      \param key  The key of the step, from StepCheckpoint::GetStepKey.
+      \param passed The result of the step.
+      \param box  The box as the step left it.
+   */
+   void AddMemo(const ULong64_t key, const bool passed,
+      const ToyBoxTPCECal& box);
+
+   /**
+      Retrieves the serial number of this EventBox. Every EventBoxTPCECal
+      created gets a new one, so it identifies the event the box belongs to.
+
+      \return  The serial number, starting from 1.
+   */
+   unsigned long GetSerial() const { return _serial; }
+
+   /// Back TPC segments of the event's candidate tracks
+   TPCBackSegmentCache segments;
+
+private:
+   EventBoxTPCECal(const EventBoxTPCECal&);
+   EventBoxTPCECal& operator=(const EventBoxTPCECal&);
+
+   /// Deletes the memoised steps, whose boxes refer to rows of the segment
+   /// cache
+   void ClearMemos();
+
+   /// The result of a memoised step and the box it left behind
+   struct Memo
+   {
+      bool Passed;
+      ToyBoxTPCECal* Box;
+   };
+
+   static unsigned long _nextSerial;
+   static bool _fillSystematicsGroups;
+
+   unsigned long _serial;
+   bool _filled;
+   SubDetId::SubDetEnum _filledDetectorFV;
+   /// The GroupSetEnum flags of the sets filled
+   unsigned int _filledGroups;
+   /// The memoised steps, by key
+   std::map<ULong64_t, Memo> _memos;
+};
+
+#endif
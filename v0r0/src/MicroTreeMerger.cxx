@@ -0,0 +1,96 @@
+#include <cstdio>
+#include <iostream>
+#include "MicroTreeMerger.hxx"
+#include "TFileMerger.h"
+#include "TFile.h"
+#include "TTree.h"
+
+MicroTreeMerger::MicroTreeMerger(const std::string& output): _output(output),
+   _firstOnlyTrees(1, "config")
+{
+}
+
+void MicroTreeMerger::AddFile(const std::string& filename)
+{
+   _inputs.push_back(filename);
+}
+
+void MicroTreeMerger::KeepFirstOnly(const std::string& tree)
+{
+   _firstOnlyTrees.push_back(tree);
+}
+
+bool MicroTreeMerger::Merge(const bool removeInputs)
+{
+   TFileMerger merger(false);
+   if(!merger.OutputFile(_output.c_str(), "RECREATE"))
+   {
+      std::cerr << "MicroTreeMerger: could not create " << _output << std::endl;
+      return false;
+   }
+
+   for(unsigned int i = 0; i < _inputs.size(); ++i)
+   {
+      if(!merger.AddFile(_inputs[i].c_str(), false))
+      {
+         std::cerr << "MicroTreeMerger: could not open " << _inputs[i] <<
+            std::endl;
+         return false;
+      }
+   }
+
+   if(!merger.Merge())
+   {
+      std::cerr << "MicroTreeMerger: failed to merge into " << _output <<
+         std::endl;
+      return false;
+   }
+
+   if(!KeepFirstTrees())
+   {
+      return false;
+   }
+
+   if(removeInputs)
+   {
+      for(unsigned int i = 0; i < _inputs.size(); ++i)
+      {
+         std::remove(_inputs[i].c_str());
+      }
+   }
+
+   return true;
+}
+
+bool MicroTreeMerger::KeepFirstTrees() const
+{
+   if(_inputs.empty())
+   {
+      return true;
+   }
+
+   TFile first(_inputs[0].c_str(), "READ");
+   TFile output(_output.c_str(), "UPDATE");
+   if(output.IsZombie())
+   {
+      std::cerr << "MicroTreeMerger: could not update " << _output << std::endl;
+      return false;
+   }
+
+   for(unsigned int i = 0; i < _firstOnlyTrees.size(); ++i)
+   {
+      const std::string& name = _firstOnlyTrees[i];
+      TTree* tree = static_cast<TTree*>(first.Get(name.c_str()));
+      if(!tree)
+      {
+         continue;
+      }
+
+      output.Delete((name + ";*").c_str());
+      output.cd();
+      tree->CloneTree(-1, "fast")->Write();
+   }
+   output.Close();
+
+   return true;
+}
@@ -0,0 +1,67 @@
+#ifndef MicroTreeMerger_h
+#define MicroTreeMerger_h
+
+#include <string>
+#include <vector>
+
+/**
+   Merges the output files of analysis jobs that each processed part of the
+   same input into a single output file.
+
+   The files are merged in the order in which they are added, so if each job
+   processed a consecutive range of events the merged micro-trees are in event
+   order. Header entries are kept per file, so the POT of the merged file is
+   the sum over the jobs. The jobs share one configuration, so only the config
+   tree of the first file is kept; appending them all would repeat it once per
+   job. Jobs that each read the whole input, and only processed part of its
+   events, also share one header, which KeepFirstOnly keeps once.
+*/
+class MicroTreeMerger
+{
+public:
+   /**
+      \param output  The file to create.
+   */
+   MicroTreeMerger(const std::string& output);
+   virtual ~MicroTreeMerger(){ }
+
+   /**
+      Adds a file to the end of the merge.
+
+      \param filename   The file to add.
+   */
+   void AddFile(const std::string& filename);
+
+   /**
+      Keeps the entries of a tree from the first file only, as for the config
+      tree.
+
+      \param tree The name of the tree.
+   */
+   void KeepFirstOnly(const std::string& tree);
+
+   /**
+      Merges the added files into the output file.
+
+      \param removeInputs  Whether to delete the added files once they have
+                           been merged.
+      \return  True if the merge succeeded, False otherwise.
+   */
+   bool Merge(const bool removeInputs = false);
+
+private:
+   /**
+      Replaces the trees of the output file that are kept from the first file
+      only, which hold the entries of every merged file, with those of the
+      first file.
+
+      \return  True if the trees were replaced, False otherwise.
+   */
+   bool KeepFirstTrees() const;
+
+   std::string _output;
+   std::vector<std::string> _inputs;
+   std::vector<std::string> _firstOnlyTrees;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include <cstring>
+#include "MicroTreeView.hxx"
+#include "TBranch.h"
+#include "TLeaf.h"
+
+MicroTreeView::MicroTreeView(TTree* tree, const int selection): _tree(tree),
+   _selection(0), _valid(false)
+{
+   for(unsigned int b = 0; b < 5; ++b)
+   {
+      _branches[b] = nullptr;
+   }
+
+   // As UseSelection in RunTPCECalPlot, the micro-tree is of every selection
+   // if its variables are arrays
+   _tree->LoadTree(0);
+   TLeaf* leaf = _tree->GetLeaf("entersBarrel");
+   if(leaf && leaf->GetLen() > 1)
+   {
+      _selection = selection;
+   }
+
+   _valid = Bind("entersBarrel", "Int_t", 1, _entersBarrel, _branches[0]) &&
+      Bind("entersDownstream", "Int_t", 1, _entersDownstream, _branches[1]) &&
+      Bind("ecalDetector", "Int_t", 1, _ecalDetector, _branches[2]) &&
+      Bind("momentum", "Float_t", 1, _momentum, _branches[3]) &&
+      Bind("direction", "Float_t", 3, _direction, _branches[4]);
+}
+
+MicroTreeView::~MicroTreeView()
+{
+   _tree->ResetBranchAddresses();
+}
+
+template<typename T>
+bool MicroTreeView::Bind(const char* name, const char* typeName,
+   const unsigned int perSelection, std::vector<T>& buffer, TBranch*& branch)
+{
+   TLeaf* leaf = _tree->GetLeaf(name);
+   if(!leaf || strcmp(leaf->GetTypeName(), typeName) ||
+      leaf->GetLen() < int(perSelection * (_selection + 1)))
+   {
+      return false;
+   }
+
+   buffer.resize(leaf->GetLen());
+   _tree->SetBranchAddress(name, &buffer[0], &branch);
+
+   return branch != nullptr;
+}
+
+bool MicroTreeView::Read(const Long64_t entry)
+{
+   Long64_t localEntry = _tree->LoadTree(entry);
+   if(localEntry < 0)
+   {
+      return false;
+   }
+
+   for(unsigned int b = 0; b < 5; ++b)
+   {
+      _branches[b]->GetEntry(localEntry);
+   }
+
+   return true;
+}
@@ -0,0 +1,90 @@
+#ifndef MicroTreeView_h
+#define MicroTreeView_h
+
+#include <vector>
+#include "TTree.h"
+
+class MicroTreeView;
+
+/// A compiled condition on the micro-tree entry read by a MicroTreeView
+typedef bool (*MicroTreePredicate)(const MicroTreeView& view);
+
+/// A compiled variable of the micro-tree entry read by a MicroTreeView
+typedef double (*MicroTreeAccessor)(const MicroTreeView& view);
+
+/**
+   Reads the ECal track variables of one selection from a micro-tree into
+   typed buffers, so that predicates and accessors compiled as native code
+   can use them in place of TTreeFormula expressions.
+
+   Micro-trees of a single selection hold the variables as scalars, whereas
+   those of a RunAllSelections run hold an entry per selection. The view
+   reads either and gives the values of its selection.
+
+   The view sets the branch addresses of the tree, and resets every branch
+   address of the tree when it is destroyed.
+*/
+class MicroTreeView
+{
+public:
+   /**
+      \param tree The micro-tree, or a chain of them.
+      \param selection  The index of the selection, for micro-trees of every
+                        selection.
+   */
+   MicroTreeView(TTree* tree, const int selection = 0);
+   virtual ~MicroTreeView();
+
+   /**
+      Checks whether the tree has every variable the view reads.
+
+      \return  True if it has, False otherwise.
+   */
+   bool IsValid() const { return _valid; }
+
+   /**
+      Reads the variables of an entry. Only the branches of the view are read.
+
+      \param entry   The entry of the tree.
+      \return  True if the entry was read, False otherwise.
+   */
+   bool Read(const Long64_t entry);
+
+   Int_t GetEntersBarrel() const { return _entersBarrel[_selection]; }
+   Int_t GetEntersDownstream() const { return _entersDownstream[_selection]; }
+   Int_t GetEcalDetector() const { return _ecalDetector[_selection]; }
+   Float_t GetMomentum() const { return _momentum[_selection]; }
+   Float_t GetCosTheta() const { return _direction[3 * _selection + 2]; }
+
+private:
+   /**
+      Binds a branch to a buffer sized to hold its leaf.
+
+      \param name The name of the branch.
+      \param typeName   The type of its leaf, e.g. "Int_t".
+      \param perSelection  The number of values of each selection.
+      \param buffer  The buffer.
+      \param branch  Set to the branch, which the tree updates if it is a
+                     chain and moves to another file.
+      \return  True if the branch was bound, False if it is missing, of
+               another type or holds too few values for the selection.
+   */
+   template<typename T>
+   bool Bind(const char* name, const char* typeName,
+      const unsigned int perSelection, std::vector<T>& buffer,
+      TBranch*& branch);
+
+   TTree* _tree;
+   unsigned int _selection;
+   bool _valid;
+
+   std::vector<Int_t> _entersBarrel;
+   std::vector<Int_t> _entersDownstream;
+   std::vector<Int_t> _ecalDetector;
+   std::vector<Float_t> _momentum;
+   std::vector<Float_t> _direction;
+   /// The branches read, in the order of the buffers
+   TBranch* _branches[5];
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include <iostream>
+#include "PreselectionIndex.hxx"
+#include "EventBoxTPCECal.hxx"
+#include "TFile.h"
+#include "TTree.h"
+
+PreselectionIndex& PreselectionIndex::Get()
+{
+   static PreselectionIndex index;
+   return index;
+}
+
+PreselectionIndex::PreselectionIndex(): _serial(0)
+{
+}
+
+StepBase* PreselectionIndex::Wrap(StepBase* step)
+{
+   return IsEnabled() ? new IndexedStep(step) : step;
+}
+
+void PreselectionIndex::Record(const AnaEventB& event)
+{
+   const EventBoxTPCECal* eventBox = &EventBoxTPCECal::Get(event);
+   if(eventBox->GetSerial() == _serial)
+   {
+      return;
+   }
+   _serial = eventBox->GetSerial();
+
+   _runs.push_back(event.EventInfo.Run);
+   _subruns.push_back(event.EventInfo.SubRun);
+   _events.push_back(event.EventInfo.Event);
+}
+
+bool PreselectionIndex::Write() const
+{
+   TFile file(_filename.c_str(), "RECREATE");
+   if(file.IsZombie())
+   {
+      std::cerr << "PreselectionIndex: could not create " << _filename <<
+         std::endl;
+      return false;
+   }
+
+   Int_t run = 0;
+   Int_t subrun = 0;
+   Int_t event = 0;
+   TTree tree("preselection", "Events passing the preselection");
+   tree.Branch("run", &run, "run/I");
+   tree.Branch("subrun", &subrun, "subrun/I");
+   tree.Branch("event", &event, "event/I");
+
+   for(unsigned int i = 0; i < _runs.size(); ++i)
+   {
+      run = _runs[i];
+      subrun = _subruns[i];
+      event = _events[i];
+      tree.Fill();
+   }
+
+   tree.Write();
+   file.Close();
+
+   return true;
+}
+
+IndexedStep::IndexedStep(StepBase* step): _step(step)
+{
+}
+
+IndexedStep::~IndexedStep()
+{
+   delete _step;
+}
+
+bool IndexedStep::Apply(AnaEventB& event, ToyBoxB& box) const
+{
+   bool passed = _step->Apply(event, box);
+   if(passed)
+   {
+      PreselectionIndex::Get().Record(event);
+   }
+
+   return passed;
+}
+
+StepBase* IndexedStep::MakeClone()
+{
+   return new IndexedStep(_step->MakeClone());
+}
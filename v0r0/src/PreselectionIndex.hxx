@@ -0,0 +1,108 @@
+#ifndef PreselectionIndex_h
+#define PreselectionIndex_h
+
+#include <string>
+#include <vector>
+#include "SelectionBase.hxx"
+
+/// Number of trunk steps, from the first, that make up the preselection of
+/// every TPC/ECal selection: the event quality, FGD + TPC and FGD FV cuts
+const unsigned int NPRESELECTIONSTEPS = 3;
+
+/**
+   Records the events that pass the preselection of any selection, and writes
+   them to a sidecar index file.
+
+   Most events fail the preselection, so RunTPCECalSkim uses the index to copy
+   only the flat tree entries of the recorded events into a much smaller flat
+   tree. Rerunning the analysis on that gives the same selected events while
+   reading a small fraction of the data.
+
+   The index holds the run, subrun and event numbers of each event in the
+   preselection tree. It does not hold the entries themselves, as these are
+   not visible to the selections, so RunTPCECalSkim finds them.
+*/
+class PreselectionIndex
+{
+public:
+   /**
+      Retrieves the index shared by all selections.
+
+      \return  The index.
+   */
+   static PreselectionIndex& Get();
+
+   virtual ~PreselectionIndex(){ }
+
+   /**
+      Sets the file to write the index to. This must be set before the
+      selections define their steps.
+
+      \param filename   The file, or empty for no index.
+   */
+   void SetFile(const std::string& filename){ _filename = filename; }
+
+   /**
+      Checks whether an index is being recorded.
+
+      \return  True if an index file is set, False otherwise.
+   */
+   bool IsEnabled() const { return !_filename.empty(); }
+
+   /**
+      Wraps the last preselection step of a selection so that the events
+      passing it are recorded, if an index is being recorded.
+
+      \param step The step.
+      \return  The step to add to the selection. This is step itself if no
+               index is being recorded.
+   */
+   StepBase* Wrap(StepBase* step);
+
+   /**
+      Records an event that passed the preselection. Each event is recorded
+      once, however many toys and selections pass it.
+
+      \param event   The event.
+   */
+   void Record(const AnaEventB& event);
+
+   /**
+      Writes the recorded events to the index file.
+
+      \return  True if the index was written, False otherwise.
+   */
+   bool Write() const;
+
+private:
+   PreselectionIndex();
+
+   std::string _filename;
+   /// Serial number of the EventBox of the last event recorded
+   unsigned long _serial;
+   std::vector<Int_t> _runs;
+   std::vector<Int_t> _subruns;
+   std::vector<Int_t> _events;
+};
+
+/**
+   A step that records the events it passes in the PreselectionIndex.
+*/
+class IndexedStep: public StepBase
+{
+public:
+   /**
+      \param step The step. This is owned by the IndexedStep.
+   */
+   IndexedStep(StepBase* step);
+   virtual ~IndexedStep();
+
+   using StepBase::Apply;
+   bool Apply(AnaEventB& event, ToyBoxB& box) const;
+   StepBase* MakeClone();
+
+private:
+   StepBase* _step;
+};
+
+#endif
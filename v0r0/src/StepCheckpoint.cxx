@@ -0,0 +1,577 @@
+#include <algorithm>
+#include <iostream>
+#include <typeinfo>
+#include "StepCheckpoint.hxx"
+#include "TPCECalSelection.hxx"
+#include "EventBoxTPCECal.hxx"
+#include "TFile.h"
+#include "TTree.h"
+
+/**
+   Finds the segment cache row of a track.
+
+   \param segments   The segment cache, or null.
+   \param track   The track, or null.
+   \return  The row of the track, or -1 if it has none.
+*/
+static int FindRow(const TPCBackSegmentCache* segments,
+   const AnaTrackB* track)
+{
+   if(!segments || !track)
+   {
+      return -1;
+   }
+   for(unsigned int i = 0; i < segments->GetNumTracks(); ++i)
+   {
+      if(segments->Track[i] == track)
+      {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+/**
+   Finds the track of a segment cache row.
+
+   \param segments   The segment cache, or null.
+   \param row  The row, or -1.
+   \return  The track, or null for row -1.
+*/
+static AnaTrackB* GetTrack(const TPCBackSegmentCache* segments, const int row)
+{
+   return (segments && row >= 0) ? segments->Track[row] : nullptr;
+}
+
+/**
+   Appends the candidates of a box to a saved state. Tracks are saved as their
+   segment cache rows, offset by one so that -1 is stored as 0.
+
+   \param box  The box.
+   \param state   The state to append to.
+*/
+static void EncodeState(const ToyBoxTPCECal& box, std::vector<int>& state)
+{
+   const TPCBackSegmentCache* segments = box.segments;
+   state.push_back(segments != nullptr);
+   state.push_back(box.isElectronLike | box.isPositronLike << 1 |
+      box.isMuonLike << 2 | box.isAntiMuonLike << 3 | box.isProtonLike << 4 |
+      box.entersBarrel << 5 | box.entersDownstream << 6);
+   state.push_back(FindRow(segments, box.downstreamTrack) + 1);
+   state.push_back(FindRow(segments, box.barrelTrack) + 1);
+   state.push_back(FindRow(segments, box.selectedTrack) + 1);
+
+   const TrackCandidateSet* sets[4] = {&box.negativeTracks,
+      &box.positiveTracks, &box.fgd1Tracks, &box.fgd2Tracks};
+   for(int s = 0; s < 4; ++s)
+   {
+      const TrackCandidateSet& tracks = *sets[s];
+      state.push_back(tracks.GetNumEntries());
+      for(unsigned int i = 0; i < tracks.GetNumEntries(); ++i)
+      {
+         state.push_back(2 * (tracks.GetIndex(i) + 1) + tracks.IsSelected(i));
+      }
+   }
+
+   const TrackPairCandidateSet& pairs = box.fgdPairedTracks;
+   state.push_back(pairs.GetNumEntries());
+   for(unsigned int i = 0; i < pairs.GetNumEntries(); ++i)
+   {
+      state.push_back(pairs[i].firstRow + 1);
+      state.push_back(pairs[i].secondRow + 1);
+      state.push_back(pairs.IsSelected(i));
+   }
+}
+
+/**
+   Restores the candidates of a box from a saved state.
+
+   \param state   The saved state.
+   \param segments   The segment cache of the current event.
+   \param box  The box to restore.
+*/
+static void DecodeState(const int* state, TPCBackSegmentCache* segments,
+   ToyBoxTPCECal& box)
+{
+   if(!*state++)
+   {
+      segments = nullptr;
+   }
+   box.segments = segments;
+
+   const int flags = *state++;
+   box.isElectronLike = flags & 1 << 0;
+   box.isPositronLike = flags & 1 << 1;
+   box.isMuonLike = flags & 1 << 2;
+   box.isAntiMuonLike = flags & 1 << 3;
+   box.isProtonLike = flags & 1 << 4;
+   box.entersBarrel = flags & 1 << 5;
+   box.entersDownstream = flags & 1 << 6;
+   box.downstreamTrack = GetTrack(segments, *state++ - 1);
+   box.barrelTrack = GetTrack(segments, *state++ - 1);
+   box.selectedTrack = GetTrack(segments, *state++ - 1);
+
+   TrackCandidateSet* sets[4] = {&box.negativeTracks, &box.positiveTracks,
+      &box.fgd1Tracks, &box.fgd2Tracks};
+   for(int s = 0; s < 4; ++s)
+   {
+      TrackCandidateSet& tracks = *sets[s];
+      tracks.Clear();
+      const int n = *state++;
+      for(int i = 0; i < n; ++i)
+      {
+         const int value = *state++;
+         const int row = value / 2 - 1;
+         tracks.Add(GetTrack(segments, row), row);
+         if(!(value & 1))
+         {
+            tracks.Reject(i);
+         }
+      }
+   }
+
+   TrackPairCandidateSet& pairs = box.fgdPairedTracks;
+   pairs.Clear();
+   const int n = *state++;
+   for(int i = 0; i < n; ++i)
+   {
+      TrackPair pair;
+      pair.firstRow = *state++ - 1;
+      pair.secondRow = *state++ - 1;
+      pair.first = GetTrack(segments, pair.firstRow);
+      pair.second = GetTrack(segments, pair.secondRow);
+      pairs.Add(pair);
+      if(!*state++)
+      {
+         pairs.Reject(i);
+      }
+   }
+}
+
+StepCheckpoint::StepCheckpoint(const std::string& selection,
+   TFile* saveFile, TFile* resumeFile): _selection(selection),
+   _saveTree(nullptr), _savePasses(0), _passPending(false),
+   _resumeTree(nullptr), _resumeDepth(0), _resumeIndexed(false),
+   _resumeResults(nullptr), _resumeState(nullptr), _resumeOffsets(nullptr),
+   _resumePasses(1), _resumePassesLeft(0), _resumeEntry(-1), _serial(0),
+   _replayDepth(0)
+{
+   TDirectory* previous = gDirectory;
+
+   if(saveFile)
+   {
+      saveFile->cd();
+      _saveTree = new TTree(("checkpoint_" + selection).c_str(),
+         "Trunk step results and candidates of each toy");
+      _saveTree->Branch("id", _saveIdValues, "id[4]/I");
+      _saveTree->Branch("results", &_saveResults);
+      _saveTree->Branch("state", &_saveState);
+      _saveTree->Branch("offsets", &_saveOffsets);
+      _saveTree->Branch("passes", &_savePasses, "passes/I");
+   }
+
+   if(resumeFile)
+   {
+      TTree* keys = static_cast<TTree*>(resumeFile->Get(
+         ("checkpointkeys_" + selection).c_str()));
+      _resumeTree = static_cast<TTree*>(resumeFile->Get(
+         ("checkpoint_" + selection).c_str()));
+      if(keys && _resumeTree)
+      {
+         ULong64_t key = 0;
+         keys->SetBranchAddress("key", &key);
+         for(Long64_t i = 0; i < keys->GetEntries(); ++i)
+         {
+            keys->GetEntry(i);
+            _resumeKeys.push_back(key);
+         }
+         keys->ResetBranchAddresses();
+
+         _resumeTree->SetBranchAddress("id", _resumeIdValues);
+         _resumeTree->SetBranchAddress("results", &_resumeResults);
+         _resumeTree->SetBranchAddress("state", &_resumeState);
+         _resumeTree->SetBranchAddress("offsets", &_resumeOffsets);
+
+         // Checkpoints saved before repeated passes were merged have an entry
+         // per pass
+         _resumePasses = 1;
+         if(_resumeTree->GetBranch("passes"))
+         {
+            _resumeTree->SetBranchAddress("passes", &_resumePasses);
+         }
+      }
+      else
+      {
+         std::cerr << "StepCheckpoint: no checkpoint of " << selection <<
+            " to resume" << std::endl;
+         _resumeTree = nullptr;
+      }
+   }
+
+   if(previous)
+   {
+      previous->cd();
+   }
+}
+
+StepCheckpoint::~StepCheckpoint()
+{
+   // The trees are owned by their files
+}
+
+ULong64_t StepCheckpoint::GetStepKey(const ULong64_t previous,
+   const std::string& title, StepBase* step)
+{
+   std::string description = typeid(*step).name();
+   description += "\n" + title + "\n";
+   TPCECalStepBase* tpcECalStep = dynamic_cast<TPCECalStepBase*>(step);
+   if(tpcECalStep)
+   {
+      description += tpcECalStep->GetConfiguration();
+   }
+
+   // 64 bit FNV-1a, continued from the key of the step before
+   ULong64_t key = previous ? previous : 14695981039346656037ULL;
+   for(unsigned int i = 0; i < description.size(); ++i)
+   {
+      key ^= static_cast<unsigned char>(description[i]);
+      key *= 1099511628211ULL;
+   }
+
+   return key;
+}
+
+bool StepCheckpoint::CanResume(const ULong64_t key) const
+{
+   return _resumeDepth == _keys.size() && _resumeDepth < _resumeKeys.size() &&
+      _resumeKeys[_resumeDepth] == key;
+}
+
+StepBase* StepCheckpoint::Wrap(StepBase* step, const ULong64_t key,
+   const std::string& title)
+{
+   if(CanResume(key))
+   {
+      ++_resumeDepth;
+   }
+   _keys.push_back(key);
+   _titles.push_back(title);
+
+   return new CheckpointedStep(step, this, _keys.size() - 1);
+}
+
+bool StepCheckpoint::Apply(StepBase& step, const unsigned int position,
+   AnaEventB& event, ToyBoxB& box)
+{
+   ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+
+   // Every toy starts at the first step of the trunk
+   if(position == 0)
+   {
+      BeginPass(event);
+   }
+
+   bool passed = false;
+   if(position < _replayDepth)
+   {
+      EventBoxTPCECal* eventBox = &EventBoxTPCECal::Get(event);
+      DecodeState(&(*_resumeState)[(*_resumeOffsets)[position]],
+         &eventBox->segments, *tpcECalBox);
+      passed = (*_resumeResults)[position];
+   }
+   else
+   {
+      passed = step.Apply(event, box);
+   }
+
+   if(_saveTree)
+   {
+      _passResults.push_back(passed);
+      if(position < _replayDepth)
+      {
+         _passState.insert(_passState.end(),
+            _resumeState->begin() + (*_resumeOffsets)[position],
+            _resumeState->begin() + (*_resumeOffsets)[position + 1]);
+      }
+      else
+      {
+         EncodeState(*tpcECalBox, _passState);
+      }
+      _passOffsets.push_back(_passState.size());
+   }
+
+   return passed;
+}
+
+void StepCheckpoint::BeginPass(AnaEventB& event)
+{
+   if(_passPending)
+   {
+      EndPass();
+   }
+
+   EventId id(event.EventInfo.Run, event.EventInfo.SubRun,
+      event.EventInfo.Event, event.Bunch);
+
+   _replayDepth = 0;
+   if(_resumeTree && _resumeDepth > 0)
+   {
+      _replayDepth = FindResumedPass(event, id);
+      if(_replayDepth > 0)
+      {
+         // FGDTPCTracksCut would have refreshed the varied columns
+         EventBoxTPCECal::Get(event).segments.Refresh();
+      }
+   }
+
+   if(_saveTree)
+   {
+      _passId = id;
+      _passResults.clear();
+      _passState.clear();
+      _passOffsets.assign(1, 0);
+      _passPending = true;
+   }
+}
+
+unsigned int StepCheckpoint::FindResumedPass(AnaEventB& event,
+   const EventId& id)
+{
+   if(!_resumeIndexed)
+   {
+      std::cout << "StepCheckpoint: " << _selection << " resumes " <<
+         _resumeDepth << " of " << _keys.size() << " trunk steps" <<
+         std::endl;
+
+      TBranch* idBranch = _resumeTree->GetBranch("id");
+      for(Long64_t i = 0; i < _resumeTree->GetEntries(); ++i)
+      {
+         idBranch->GetEntry(i);
+         _resumeIndex.insert(std::make_pair(EventId(_resumeIdValues[0],
+            _resumeIdValues[1], _resumeIdValues[2], _resumeIdValues[3]), i));
+      }
+      _resumeIndexed = true;
+   }
+
+   // The passes of an event were saved consecutively, with repeated passes
+   // saved once
+   const EventBoxTPCECal* eventBox = &EventBoxTPCECal::Get(event);
+   if(eventBox->GetSerial() != _serial)
+   {
+      _serial = eventBox->GetSerial();
+      std::map<EventId, Long64_t>::const_iterator first =
+         _resumeIndex.find(id);
+      _resumeEntry = (first != _resumeIndex.end()) ? first->second : -1;
+   }
+   else if(_resumeEntry >= 0 && --_resumePassesLeft > 0)
+   {
+      return std::min<unsigned int>(_resumeDepth, _resumeResults->size());
+   }
+   else if(_resumeEntry >= 0)
+   {
+      ++_resumeEntry;
+   }
+
+   if(_resumeEntry < 0 || _resumeEntry >= _resumeTree->GetEntries())
+   {
+      _resumeEntry = -1;
+      return 0;
+   }
+
+   _resumeTree->GetEntry(_resumeEntry);
+   if(EventId(_resumeIdValues[0], _resumeIdValues[1], _resumeIdValues[2],
+      _resumeIdValues[3]) != id)
+   {
+      // More toys than were saved
+      _resumeEntry = -1;
+      return 0;
+   }
+   _resumePassesLeft = _resumePasses;
+
+   return std::min<unsigned int>(_resumeDepth, _resumeResults->size());
+}
+
+void StepCheckpoint::EndPass()
+{
+   _passPending = false;
+
+   // The toys of an event often leave the same results and candidates, so
+   // they share an entry
+   if(_savePasses > 0 && _passId == EventId(_saveIdValues[0],
+      _saveIdValues[1], _saveIdValues[2], _saveIdValues[3]) &&
+      _passResults == _saveResults && _passOffsets == _saveOffsets &&
+      _passState == _saveState)
+   {
+      ++_savePasses;
+      return;
+   }
+
+   if(_savePasses > 0)
+   {
+      _saveTree->Fill();
+   }
+   _saveIdValues[0] = std::get<0>(_passId);
+   _saveIdValues[1] = std::get<1>(_passId);
+   _saveIdValues[2] = std::get<2>(_passId);
+   _saveIdValues[3] = std::get<3>(_passId);
+   _saveResults.swap(_passResults);
+   _saveState.swap(_passState);
+   _saveOffsets.swap(_passOffsets);
+   _savePasses = 1;
+}
+
+void StepCheckpoint::Write()
+{
+   _resumeTree = nullptr;
+   _resumeDepth = 0;
+   if(!_saveTree)
+   {
+      return;
+   }
+   if(_passPending)
+   {
+      EndPass();
+   }
+   if(_savePasses > 0)
+   {
+      _saveTree->Fill();
+      _savePasses = 0;
+   }
+
+   TDirectory* previous = gDirectory;
+   _saveTree->GetCurrentFile()->cd();
+   _saveTree->Write();
+
+   TTree keys(("checkpointkeys_" + _selection).c_str(),
+      "Configuration key of each trunk step");
+   ULong64_t key = 0;
+   std::string title;
+   keys.Branch("key", &key, "key/l");
+   keys.Branch("title", &title);
+   for(unsigned int i = 0; i < _keys.size(); ++i)
+   {
+      key = _keys[i];
+      title = _titles[i];
+      keys.Fill();
+   }
+   keys.Write();
+   _saveTree = nullptr;
+
+   if(previous)
+   {
+      previous->cd();
+   }
+}
+
+StepCheckpointer& StepCheckpointer::Get()
+{
+   static StepCheckpointer checkpointer;
+   return checkpointer;
+}
+
+StepCheckpointer::StepCheckpointer(): _saveFile(nullptr),
+   _resumeFile(nullptr)
+{
+}
+
+StepCheckpointer::~StepCheckpointer()
+{
+   for(unsigned int i = 0; i < _checkpoints.size(); ++i)
+   {
+      delete _checkpoints[i];
+   }
+}
+
+void StepCheckpointer::SetFiles(const std::string& saveFile,
+   const std::string& resumeFile)
+{
+   _saveFileName = saveFile;
+   _resumeFileName = resumeFile;
+}
+
+StepCheckpoint* StepCheckpointer::Create(const std::string& selection)
+{
+   if(_saveFileName.empty() && _resumeFileName.empty())
+   {
+      return nullptr;
+   }
+
+   TDirectory* previous = gDirectory;
+   if(!_saveFileName.empty() && !_saveFile)
+   {
+      _saveFile = new TFile(_saveFileName.c_str(), "RECREATE");
+      if(_saveFile->IsZombie())
+      {
+         std::cerr << "StepCheckpointer: could not create " <<
+            _saveFileName << std::endl;
+         delete _saveFile;
+         _saveFile = nullptr;
+         _saveFileName.clear();
+      }
+   }
+   if(!_resumeFileName.empty() && !_resumeFile)
+   {
+      _resumeFile = new TFile(_resumeFileName.c_str(), "READ");
+      if(_resumeFile->IsZombie())
+      {
+         std::cerr << "StepCheckpointer: could not open " <<
+            _resumeFileName << std::endl;
+         delete _resumeFile;
+         _resumeFile = nullptr;
+         _resumeFileName.clear();
+      }
+   }
+   if(previous)
+   {
+      previous->cd();
+   }
+
+   StepCheckpoint* checkpoint = new StepCheckpoint(selection, _saveFile,
+      _resumeFile);
+   _checkpoints.push_back(checkpoint);
+
+   return checkpoint;
+}
+
+void StepCheckpointer::Close()
+{
+   for(unsigned int i = 0; i < _checkpoints.size(); ++i)
+   {
+      _checkpoints[i]->Write();
+   }
+
+   if(_saveFile)
+   {
+      _saveFile->Close();
+      delete _saveFile;
+      _saveFile = nullptr;
+   }
+   if(_resumeFile)
+   {
+      _resumeFile->Close();
+      delete _resumeFile;
+      _resumeFile = nullptr;
+   }
+}
+
+CheckpointedStep::CheckpointedStep(StepBase* step, StepCheckpoint* checkpoint,
+   const unsigned int position): _step(step), _checkpoint(checkpoint),
+   _position(position)
+{
+}
+
+CheckpointedStep::~CheckpointedStep()
+{
+   delete _step;
+}
+
+bool CheckpointedStep::Apply(AnaEventB& event, ToyBoxB& box) const
+{
+   return _checkpoint->Apply(*_step, _position, event, box);
+}
+
+StepBase* CheckpointedStep::MakeClone()
+{
+   return new CheckpointedStep(_step->MakeClone(), _checkpoint, _position);
+}
@@ -0,0 +1,234 @@
+#ifndef StepCheckpoint_h
+#define StepCheckpoint_h
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "SelectionBase.hxx"
+
+class TFile;
+class TTree;
+class ToyBoxTPCECal;
+
+/**
+   Saves the trunk steps of one selection for every toy of every event: the
+   result of each step and the candidates it leaves, together with a key of the
+   configuration of the step and of every step before it. Consecutive toys of
+   an event that leave the same results and candidates share one entry.
+
+   A later run can resume from the saved checkpoint. The leading steps whose
+   keys are unchanged replay their saved results and candidates, so only the
+   steps from the first changed one on are applied. Retuning a late cut then
+   only costs the steps from that cut on.
+
+   The key of a step covers its class, its title and, for a TPCECalStepBase,
+   its GetConfiguration. A change to the code of a step that leaves these
+   unchanged is not detected, so needs a new checkpoint.
+
+   Candidates are saved as segment cache rows, so the checkpoint is only valid
+   for the same input files. The toys of an event are matched in order, which
+   needs the same configurations and number of toys.
+
+   Resuming still reads every event of the input, and applies every step to
+   the events the checkpoint does not hold. To read only the events that pass
+   the preselection, save the checkpoint together with a preselection index
+   (--index), skim the input with RunTPCECalSkim, and resume on the skim. The
+   skimmed events keep all of their tracks, so their segment cache rows are
+   those of the checkpoint.
+*/
+class StepCheckpoint
+{
+public:
+   /**
+      \param selection  The name of the selection.
+      \param saveFile   The file to save the checkpoint to, or null.
+      \param resumeFile The file to resume from, or null.
+   */
+   StepCheckpoint(const std::string& selection, TFile* saveFile,
+      TFile* resumeFile);
+   virtual ~StepCheckpoint();
+
+   /**
+      Computes the key of a step.
+
+      \param previous   The key of the step before, or 0 for the first step.
+      \param title   The title of the step.
+      \param step The step.
+      \return  The key.
+   */
+   static ULong64_t GetStepKey(const ULong64_t previous,
+      const std::string& title, StepBase* step);
+
+   /**
+      Checks whether the next step added can be resumed: its key and those of
+      every step before it match the checkpoint resumed from.
+
+      \param key  The key of the next step.
+      \return  True if the step can be resumed, False otherwise.
+   */
+   bool CanResume(const ULong64_t key) const;
+
+   /**
+      Adds the next trunk step.
+
+      \param step The step.
+      \param key  The key of the step.
+      \param title   The title of the step.
+      \return  The step to add to the selection in its place.
+   */
+   StepBase* Wrap(StepBase* step, const ULong64_t key,
+      const std::string& title);
+
+   /**
+      Applies a trunk step, or replays it from the checkpoint, and saves the
+      result.
+
+      \param step The step.
+      \param position   The position of the step in the trunk.
+      \param event   The event.
+      \param box  The box of the toy.
+      \return  The result of the step.
+   */
+   bool Apply(StepBase& step, const unsigned int position, AnaEventB& event,
+      ToyBoxB& box);
+
+   /**
+      Writes the saved checkpoint to the save file. The checkpoint neither
+      saves nor resumes after this, as its files are about to be closed.
+   */
+   void Write();
+
+private:
+   /// Identifies the event of a pass: run, subrun, event and bunch
+   typedef std::tuple<Int_t, Int_t, Int_t, Int_t> EventId;
+
+   /// Starts the pass of a toy through the trunk
+   void BeginPass(AnaEventB& event);
+
+   /// Finds the replayed pass of the current toy, returning the number of
+   /// steps it can replay
+   unsigned int FindResumedPass(AnaEventB& event, const EventId& id);
+
+   /// Adds the current pass to the saved checkpoint, either as a repeat of
+   /// the last entry or as a new one
+   void EndPass();
+
+   std::string _selection;
+
+   std::vector<ULong64_t> _keys;
+   std::vector<std::string> _titles;
+
+   TTree* _saveTree;
+   Int_t _saveIdValues[4];
+   std::vector<int> _saveResults;
+   std::vector<int> _saveState;
+   std::vector<int> _saveOffsets;
+   /// Number of passes the pending entry holds, or 0 if there is none
+   Int_t _savePasses;
+
+   /// The pass of the current toy, which becomes or repeats the pending entry
+   EventId _passId;
+   std::vector<int> _passResults;
+   std::vector<int> _passState;
+   std::vector<int> _passOffsets;
+   bool _passPending;
+
+   TTree* _resumeTree;
+   std::vector<ULong64_t> _resumeKeys;
+   /// Number of leading steps whose keys match the resumed checkpoint
+   unsigned int _resumeDepth;
+   /// First entry of each event in the resumed checkpoint
+   std::map<EventId, Long64_t> _resumeIndex;
+   bool _resumeIndexed;
+   Int_t _resumeIdValues[4];
+   std::vector<int>* _resumeResults;
+   std::vector<int>* _resumeState;
+   std::vector<int>* _resumeOffsets;
+   Int_t _resumePasses;
+   /// Number of the passes of the current entry not yet replayed
+   Int_t _resumePassesLeft;
+   Long64_t _resumeEntry;
+   /// Serial number of the EventBox of the current event
+   unsigned long _serial;
+   /// Number of steps replayed in the current pass
+   unsigned int _replayDepth;
+};
+
+/**
+   Holds the checkpoint files and the StepCheckpoint of each selection.
+
+   The files are set by the application, before the selections are defined.
+   Checkpoints are only created if a file to save to or resume from is set, so
+   otherwise the selections run exactly the steps they define.
+*/
+class StepCheckpointer
+{
+public:
+   /**
+      Retrieves the checkpointer shared by all selections.
+
+      \return  The checkpointer.
+   */
+   static StepCheckpointer& Get();
+
+   virtual ~StepCheckpointer();
+
+   /**
+      Sets the checkpoint files.
+
+      \param saveFile   The file to save the checkpoint to, or empty for none.
+      \param resumeFile The file to resume from, or empty for none.
+   */
+   void SetFiles(const std::string& saveFile, const std::string& resumeFile);
+
+   /**
+      Creates the checkpoint of a selection.
+
+      \param selection  The name of the selection.
+      \return  The checkpoint, or null if checkpoints are not in use.
+   */
+   StepCheckpoint* Create(const std::string& selection);
+
+   /**
+      Writes the saved checkpoints and closes the files.
+   */
+   void Close();
+
+private:
+   StepCheckpointer();
+
+   std::string _saveFileName;
+   std::string _resumeFileName;
+   TFile* _saveFile;
+   TFile* _resumeFile;
+   std::vector<StepCheckpoint*> _checkpoints;
+};
+
+/**
+   A trunk step of a StepCheckpoint. Clones share the checkpoint of the
+   original, so clones must not be applied concurrently.
+*/
+class CheckpointedStep: public StepBase
+{
+public:
+   /**
+      \param step The step. This is owned by the CheckpointedStep.
+      \param checkpoint The checkpoint of the selection.
+      \param position   The position of the step in the trunk.
+   */
+   CheckpointedStep(StepBase* step, StepCheckpoint* checkpoint,
+      const unsigned int position);
+   virtual ~CheckpointedStep();
+
+   using StepBase::Apply;
+   bool Apply(AnaEventB& event, ToyBoxB& box) const;
+   StepBase* MakeClone();
+
+private:
+   StepBase* _step;
+   StepCheckpoint* _checkpoint;
+   unsigned int _position;
+};
+
+#endif
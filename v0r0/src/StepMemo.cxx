@@ -0,0 +1,65 @@
+#include "StepMemo.hxx"
+#include "TPCECalSelection.hxx"
+#include "EventBoxTPCECal.hxx"
+
+StepMemo::StepMemo()
+{
+}
+
+StepMemo::~StepMemo()
+{
+}
+
+StepBase* StepMemo::Wrap(StepBase* step, const ULong64_t key)
+{
+   _keys.push_back(key);
+
+   return new MemoisedStep(step, this, _keys.size() - 1);
+}
+
+bool StepMemo::Apply(StepBase& step, const unsigned int position,
+   AnaEventB& event, ToyBoxB& box)
+{
+   ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+   EventBoxTPCECal& eventBox = EventBoxTPCECal::Get(event);
+
+   bool passed = false;
+   const ToyBoxTPCECal* recorded = eventBox.FindMemo(_keys[position], passed);
+   if(recorded)
+   {
+      // Every toy starts at the first step, and FGDTPCTracksCut refreshes the
+      // varied columns for each toy
+      if(position == 0)
+      {
+         eventBox.segments.Refresh();
+      }
+
+      tpcECalBox->CopyState(*recorded);
+      return passed;
+   }
+
+   passed = step.Apply(event, box);
+   eventBox.AddMemo(_keys[position], passed, *tpcECalBox);
+
+   return passed;
+}
+
+MemoisedStep::MemoisedStep(StepBase* step, StepMemo* memo,
+   const unsigned int position): _step(step), _memo(memo), _position(position)
+{
+}
+
+MemoisedStep::~MemoisedStep()
+{
+   delete _step;
+}
+
+bool MemoisedStep::Apply(AnaEventB& event, ToyBoxB& box) const
+{
+   return _memo->Apply(*_step, _position, event, box);
+}
+
+StepBase* MemoisedStep::MakeClone()
+{
+   return new MemoisedStep(_step->MakeClone(), _memo, _position);
+}
@@ -0,0 +1,90 @@
+#ifndef StepMemo_h
+#define StepMemo_h
+
+#include <vector>
+#include "SelectionBase.hxx"
+
+class ToyBoxTPCECal;
+
+/**
+   Memoises the toy-invariant steps at the start of the trunk of a selection,
+   after any resumed from a StepCheckpoint.
+
+   None of these steps read a systematically varied quantity, so they give the
+   same results, and leave the same candidates, for every toy of an event. The
+   first toy to apply one records its result and the box it leaves behind in
+   the EventBoxTPCECal of the event. Every later toy replays the recorded
+   result and box instead of applying the step again.
+
+   The record is kept by the key of the configuration of the step and of every
+   step before it, as computed by StepCheckpoint::GetStepKey. The EventBox is
+   shared by all the selections, so a selection whose leading steps match
+   those of another replays them too, and the common preselection is applied
+   once per event however many selections are enabled.
+*/
+class StepMemo
+{
+public:
+   StepMemo();
+   virtual ~StepMemo();
+
+   /**
+      Adds a step to the end of the memoised steps. The steps must be added in
+      the order they are applied, starting with the first step of the trunk.
+
+      \param step The step to memoise.
+      \param key  The key of the step, from StepCheckpoint::GetStepKey.
+      \return  The step to add to the selection in its place.
+   */
+   StepBase* Wrap(StepBase* step, const ULong64_t key);
+
+   /**
+      Retrieves the number of steps memoised.
+
+      \return  The number of steps.
+   */
+   unsigned int GetNumSteps() const { return _keys.size(); }
+
+   /**
+      Applies a memoised step, or replays its recorded result.
+
+      \param step The step.
+      \param position   The position of the step in the memoised steps.
+      \param event   The event.
+      \param box  The box of the toy.
+      \return  The result of the step.
+   */
+   bool Apply(StepBase& step, const unsigned int position, AnaEventB& event,
+      ToyBoxB& box);
+
+private:
+   /// Key of each step
+   std::vector<ULong64_t> _keys;
+};
+
+/**
+   A step of a StepMemo. The record it replays is kept in the EventBox, which
+   is updated without locking, so clones must not be applied concurrently.
+*/
+class MemoisedStep: public StepBase
+{
+public:
+   /**
+      \param step The step to memoise. This is owned by the MemoisedStep.
+      \param memo The memo the step belongs to.
+      \param position   The position of the step in the memo.
+   */
+   MemoisedStep(StepBase* step, StepMemo* memo, const unsigned int position);
+   virtual ~MemoisedStep();
+
+   using StepBase::Apply;
+   bool Apply(AnaEventB& event, ToyBoxB& box) const;
+   StepBase* MakeClone();
+
+private:
+   StepBase* _step;
+   StepMemo* _memo;
+   unsigned int _position;
+};
+
+#endif
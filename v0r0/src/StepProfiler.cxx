@@ -0,0 +1,200 @@
+#include <chrono>
+#include <iomanip>
+#include "StepProfiler.hxx"
+#include "TPCECalSelection.hxx"
+#include "TFile.h"
+#include "TTree.h"
+
+StepProfiler& StepProfiler::Get()
+{
+   static StepProfiler profiler;
+   return profiler;
+}
+
+StepProfiler::StepProfiler(): _enabled(false)
+{
+}
+
+StepProfiler::~StepProfiler()
+{
+   for(unsigned int i = 0; i < _profiles.size(); ++i)
+   {
+      delete _profiles[i];
+   }
+}
+
+StepBase* StepProfiler::Wrap(StepBase* step, const std::string& selection,
+   const Int_t branch, const std::string& title)
+{
+   if(!_enabled)
+   {
+      return step;
+   }
+
+   return new ProfiledStep(step, AddProfile(selection, branch, title));
+}
+
+StepProfile* StepProfiler::AddProfile(const std::string& selection,
+   const Int_t branch, const std::string& title)
+{
+   StepProfile* profile = new StepProfile();
+   profile->Selection = selection;
+   profile->Branch = branch;
+   profile->Title = title;
+   profile->Calls = 0;
+   profile->Passed = 0;
+   profile->Seconds = 0;
+   profile->CandidatesIn = 0;
+   profile->CandidatesOut = 0;
+   _profiles.push_back(profile);
+
+   return profile;
+}
+
+bool StepProfiler::Read(const std::string& filename)
+{
+   TFile file(filename.c_str(), "READ");
+   TTree* tree = file.IsZombie() ? nullptr :
+      static_cast<TTree*>(file.Get("stepprofile"));
+   if(!tree)
+   {
+      return false;
+   }
+
+   std::string* selection = nullptr;
+   std::string* title = nullptr;
+   StepProfile row;
+   tree->SetBranchAddress("selection", &selection);
+   tree->SetBranchAddress("branch", &row.Branch);
+   tree->SetBranchAddress("title", &title);
+   tree->SetBranchAddress("calls", &row.Calls);
+   tree->SetBranchAddress("passed", &row.Passed);
+   tree->SetBranchAddress("seconds", &row.Seconds);
+   tree->SetBranchAddress("candidatesIn", &row.CandidatesIn);
+   tree->SetBranchAddress("candidatesOut", &row.CandidatesOut);
+
+   for(Long64_t i = 0; i < tree->GetEntries(); ++i)
+   {
+      tree->GetEntry(i);
+      StepProfile* profile = nullptr;
+      for(unsigned int j = 0; j < _profiles.size() && !profile; ++j)
+      {
+         if(_profiles[j]->Selection == *selection &&
+            _profiles[j]->Branch == row.Branch && _profiles[j]->Title == *title)
+         {
+            profile = _profiles[j];
+         }
+      }
+      if(!profile)
+      {
+         profile = AddProfile(*selection, row.Branch, *title);
+      }
+      profile->Calls += row.Calls;
+      profile->Passed += row.Passed;
+      profile->Seconds += row.Seconds;
+      profile->CandidatesIn += row.CandidatesIn;
+      profile->CandidatesOut += row.CandidatesOut;
+   }
+
+   tree->ResetBranchAddresses();
+   delete selection;
+   delete title;
+
+   return true;
+}
+
+void StepProfiler::Print(std::ostream& os) const
+{
+   os << std::endl << "Step profile" << std::endl;
+   os << std::left << std::setw(12) << "Selection" << std::right <<
+      std::setw(7) << "Branch" << "  " << std::left << std::setw(20) <<
+      "Step" << std::right << std::setw(12) << "Calls" << std::setw(12) <<
+      "Passed" << std::setw(12) << "Time (s)" << std::setw(12) <<
+      "us/call" << std::setw(14) << "Cands in" << std::setw(14) <<
+      "Cands out" << std::endl;
+
+   for(unsigned int i = 0; i < _profiles.size(); ++i)
+   {
+      const StepProfile& profile = *_profiles[i];
+      double perCall = profile.Calls ?
+         1e6 * profile.Seconds / profile.Calls : 0;
+      os << std::left << std::setw(12) << profile.Selection << std::right <<
+         std::setw(7) << profile.Branch << "  " << std::left <<
+         std::setw(20) << profile.Title << std::right << std::setw(12) <<
+         profile.Calls << std::setw(12) << profile.Passed << std::fixed <<
+         std::setprecision(3) << std::setw(12) << profile.Seconds <<
+         std::setw(12) << perCall << std::setw(14) << profile.CandidatesIn <<
+         std::setw(14) << profile.CandidatesOut << std::endl;
+      os.unsetf(std::ios_base::floatfield);
+   }
+}
+
+void StepProfiler::Write(const std::string& filename) const
+{
+   TFile file(filename.c_str(), "UPDATE");
+   if(file.IsZombie())
+   {
+      std::cerr << "StepProfiler: could not open " << filename << std::endl;
+      return;
+   }
+
+   file.Delete("stepprofile;*");
+   file.cd();
+
+   StepProfile profile;
+   TTree tree("stepprofile", "Timing and candidate flow of selection steps");
+   tree.Branch("selection", &profile.Selection);
+   tree.Branch("branch", &profile.Branch, "branch/I");
+   tree.Branch("title", &profile.Title);
+   tree.Branch("calls", &profile.Calls, "calls/L");
+   tree.Branch("passed", &profile.Passed, "passed/L");
+   tree.Branch("seconds", &profile.Seconds, "seconds/D");
+   tree.Branch("candidatesIn", &profile.CandidatesIn, "candidatesIn/L");
+   tree.Branch("candidatesOut", &profile.CandidatesOut, "candidatesOut/L");
+
+   for(unsigned int i = 0; i < _profiles.size(); ++i)
+   {
+      profile = *_profiles[i];
+      tree.Fill();
+   }
+
+   tree.Write();
+   file.Close();
+}
+
+ProfiledStep::ProfiledStep(StepBase* step, StepProfile* profile):
+   _step(step), _profile(profile)
+{
+}
+
+ProfiledStep::~ProfiledStep()
+{
+   delete _step;
+}
+
+bool ProfiledStep::Apply(AnaEventB& event, ToyBoxB& box) const
+{
+   const ToyBoxTPCECal& tpcECalBox = static_cast<const ToyBoxTPCECal&>(box);
+   _profile->CandidatesIn += tpcECalBox.GetNumCandidates();
+
+   std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+   bool passed = _step->Apply(event, box);
+   std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+   _profile->Seconds += elapsed.count();
+   _profile->CandidatesOut += tpcECalBox.GetNumCandidates();
+   ++_profile->Calls;
+   if(passed)
+   {
+      ++_profile->Passed;
+   }
+
+   return passed;
+}
+
+StepBase* ProfiledStep::MakeClone()
+{
+   return new ProfiledStep(_step->MakeClone(), _profile);
+}
@@ -0,0 +1,146 @@
+#ifndef StepProfiler_h
+#define StepProfiler_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SelectionBase.hxx"
+
+/// Timing and candidate flow of one step of a selection
+struct StepProfile
+{
+   /// The selection the step belongs to
+   std::string Selection;
+   /// The branch of the step, or -1 if it is in the trunk
+   Int_t Branch;
+   /// The title the step was added with
+   std::string Title;
+   /// Number of times the step was applied
+   Long64_t Calls;
+   /// Number of times the step returned true
+   Long64_t Passed;
+   /// Total wall time spent in the step, in seconds
+   Double_t Seconds;
+   /// Total number of selected candidates before the step was applied
+   Long64_t CandidatesIn;
+   /// Total number of selected candidates after the step was applied
+   Long64_t CandidatesOut;
+};
+
+/**
+   Records the wall time, calls and candidate flow of every selection step.
+
+   Profiling is enabled with the Profiling.ProfileSteps parameter. Steps are
+   only wrapped when it is enabled, so when disabled the selections run
+   exactly the steps they define and profiling costs nothing.
+*/
+class StepProfiler
+{
+public:
+   /**
+      Retrieves the profiler shared by all selections.
+
+      \return  The profiler.
+   */
+   static StepProfiler& Get();
+
+   virtual ~StepProfiler();
+
+   /**
+      Enables or disables profiling. This must be set before the selections
+      define their steps.
+
+      \param enabled Whether steps added from now on are profiled.
+   */
+   void SetEnabled(const bool enabled){ _enabled = enabled; }
+
+   /**
+      Checks whether profiling is enabled.
+
+      \return  True if steps are being profiled, False otherwise.
+   */
+   bool IsEnabled() const { return _enabled; }
+
+   /**
+      Wraps a step so that it is profiled, if profiling is enabled.
+
+      \param step The step to profile.
+      \param selection  The name of the selection the step is added to.
+      \param branch  The branch of the step, or -1 if it is in the trunk.
+      \param title   The title of the step.
+      \return  The step to add to the selection. This is step itself if
+               profiling is disabled.
+   */
+   StepBase* Wrap(StepBase* step, const std::string& selection,
+      const Int_t branch, const std::string& title);
+
+   /**
+      Adds the rows of the stepprofile tree of a file to the profiles. Rows
+      with the same selection, branch and title, e.g. from the workers whose
+      outputs were merged into the file, are summed into one profile.
+
+      \param filename   The file to read.
+      \return  True if the file has a stepprofile tree, False otherwise.
+   */
+   bool Read(const std::string& filename);
+
+   /**
+      Prints a table of the profiles of all steps, in the order they were
+      added.
+
+      \param os   The stream to print to.
+   */
+   void Print(std::ostream& os = std::cout) const;
+
+   /**
+      Writes the profiles as the stepprofile tree of a ROOT file, with one
+      entry per step. Any stepprofile tree already in the file is replaced.
+
+      \param filename   The file to update, normally the output file of the
+                        analysis.
+   */
+   void Write(const std::string& filename) const;
+
+private:
+   StepProfiler();
+
+   /**
+      Adds an empty profile.
+
+      \param selection  The name of the selection of the step.
+      \param branch  The branch of the step, or -1 if it is in the trunk.
+      \param title   The title of the step.
+      \return  The profile.
+   */
+   StepProfile* AddProfile(const std::string& selection, const Int_t branch,
+      const std::string& title);
+
+   bool _enabled;
+   std::vector<StepProfile*> _profiles;
+};
+
+/**
+   A step that applies another step and adds its timing and candidate flow to
+   a StepProfile. Clones share the profile of the original, which is updated
+   without locking, so clones must not be applied concurrently.
+*/
+class ProfiledStep: public StepBase
+{
+public:
+   /**
+      \param step The step to profile. This is owned by the ProfiledStep.
+      \param profile The profile to add to.
+   */
+   ProfiledStep(StepBase* step, StepProfile* profile);
+   virtual ~ProfiledStep();
+
+   using StepBase::Apply;
+   bool Apply(AnaEventB& event, ToyBoxB& box) const;
+   StepBase* MakeClone();
+
+private:
+   StepBase* _step;
+   StepProfile* _profile;
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "TPCBackSegmentCache.hxx"
+#include "AnalysisUtils.hxx"
+#include "EventBoxUtils.hxx"
+#include "CutUtils.hxx"
+
+unsigned long TPCBackSegmentCache::_nOverflows = 0;
+
+TPCBackSegmentCache::TPCBackSegmentCache(): _nTracks(0), _nFGD1Tracks(0),
+   _nFGDTracks(0)
+{
+   Reserve(NMAXTPCECALCANDIDATES);
+}
+
+void TPCBackSegmentCache::Build(const AnaEventB& event,
+   const SubDetId::SubDetEnum det)
+{
+   _nTracks = 0;
+   _nFGD1Tracks = 0;
+   _nFGDTracks = 0;
+
+   EventBoxB* eventBox = event.EventBoxes[AnaEventB::kEventBoxTracker];
+   if(!eventBox)
+   {
+      return;
+   }
+
+   bool useFGD1 = (det == SubDetId::kFGD || det == SubDetId::kFGD1);
+   bool useFGD2 = (det == SubDetId::kFGD || det == SubDetId::kFGD2);
+
+   EventBoxTracker::TrackGroupEnum fgd1GroupID =
+      EventBoxTracker::kTracksWithGoodQualityTPCInFGD1FV;
+   EventBoxTracker::TrackGroupEnum fgd2GroupID =
+      EventBoxTracker::kTracksWithGoodQualityTPCInFGD2FV;
+   Reserve((useFGD1 ? eventBox->nTracksInGroup[fgd1GroupID] : 0) +
+      (useFGD2 ? eventBox->nTracksInGroup[fgd2GroupID] : 0));
+
+   if(useFGD1)
+   {
+      for(Int_t i = 0; i < eventBox->nTracksInGroup[fgd1GroupID]; ++i)
+      {
+         Track[_nTracks] = eventBox->TracksInGroup[fgd1GroupID][i];
+         FillRow(_nTracks++);
+      }
+   }
+   _nFGD1Tracks = _nTracks;
+
+   if(useFGD2)
+   {
+      for(Int_t i = 0; i < eventBox->nTracksInGroup[fgd2GroupID]; ++i)
+      {
+         Track[_nTracks] = eventBox->TracksInGroup[fgd2GroupID][i];
+         FillRow(_nTracks++);
+      }
+   }
+   _nFGDTracks = _nTracks;
+
+   // Positions are not varied by the toys, so the fiducial volume cut is
+   // evaluated once here for all of them
+   for(unsigned int i = 0; i < _nFGDTracks; ++i)
+   {
+      InFGDFV[i] = cutUtils::FiducialCut(*Track[i],
+         i < _nFGD1Tracks ? SubDetId::kFGD1 : SubDetId::kFGD2);
+   }
+}
+
+void TPCBackSegmentCache::Refresh()
+{
+   for(unsigned int i = 0; i < _nTracks; ++i)
+   {
+      FillVariedColumns(i);
+   }
+}
+
+int TPCBackSegmentCache::FindOrAdd(AnaTrackB* track)
+{
+   for(unsigned int i = 0; i < _nTracks; ++i)
+   {
+      if(Track[i] == track)
+      {
+         return i;
+      }
+   }
+
+   Reserve(_nTracks + 1);
+   Track[_nTracks] = track;
+   InFGDFV[_nTracks] = false;
+   FillRow(_nTracks);
+
+   return _nTracks++;
+}
+
+void TPCBackSegmentCache::Reserve(const unsigned int size)
+{
+   // Only the first row past the limit counts the event
+   if(size > NMAXTPCECALCANDIDATES && _nTracks <= NMAXTPCECALCANDIDATES)
+   {
+      if(_nOverflows++ == 0)
+      {
+         std::cerr << "TPCBackSegmentCache: more than " <<
+            NMAXTPCECALCANDIDATES << " candidate tracks in an event. No track "
+            "is lost, but the cache and candidate sets have to grow, so "
+            "NMAXTPCECALCANDIDATES should be raised." << std::endl;
+      }
+   }
+
+   if(size <= Track.size())
+   {
+      return;
+   }
+
+   const unsigned int newSize = std::max<unsigned int>(size, 2 * Track.size());
+   Track.resize(newSize);
+   Segment.resize(newSize);
+   TrackMomentum.resize(newSize);
+   TrackCharge.resize(newSize);
+   for(int j = 0; j < 3; ++j)
+   {
+      PositionEnd[j].resize(newSize);
+      DirectionEnd[j].resize(newSize);
+   }
+   Momentum.resize(newSize);
+   Charge.resize(newSize);
+   NHits.resize(newSize);
+   InFGDFV.resize(newSize);
+   Pullmu.resize(newSize);
+   Pullele.resize(newSize);
+   Pullpi.resize(newSize);
+   Pullp.resize(newSize);
+}
+
+void TPCBackSegmentCache::FillRow(const unsigned int row)
+{
+   Segment[row] = static_cast<AnaTpcTrack*>(
+      anaUtils::GetTPCBackSegment(Track[row]));
+
+   AnaTpcTrack* segment = Segment[row];
+   for(int j = 0; j < 3; ++j)
+   {
+      PositionEnd[j][row] = segment ? segment->PositionEnd[j] : NAN;
+      DirectionEnd[j][row] = segment ? segment->DirectionEnd[j] : NAN;
+   }
+   NHits[row] = segment ? segment->NHits : 0;
+
+   FillVariedColumns(row);
+}
+
+void TPCBackSegmentCache::FillVariedColumns(const unsigned int row)
+{
+   AnaTrackB* track = Track[row];
+   TrackMomentum[row] = track->Momentum;
+   TrackCharge[row] = track->Charge;
+
+   AnaTpcTrack* segment = Segment[row];
+   if(segment)
+   {
+      Momentum[row] = segment->Momentum;
+      Charge[row] = segment->Charge;
+      Pullmu[row] = segment->Pullmu;
+      Pullele[row] = segment->Pullele;
+      Pullpi[row] = segment->Pullpi;
+      Pullp[row] = segment->Pullp;
+   }
+   else
+   {
+      Momentum[row] = NAN;
+      Charge[row] = NAN;
+      Pullmu[row] = NAN;
+      Pullele[row] = NAN;
+      Pullpi[row] = NAN;
+      Pullp[row] = NAN;
+   }
+}
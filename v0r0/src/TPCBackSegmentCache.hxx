@@ -0,0 +1,157 @@
+#ifndef TPCBackSegmentCache_h
+#define TPCBackSegmentCache_h
+
+#include <vector>
+#include "BaseDataClasses.hxx"
+#include "SubDetId.hxx"
+
+/// Number of candidate tracks handled per event before the containers grow
+const unsigned int NMAXTPCECALCANDIDATES = 256;
+
+/**
+   A per-event, structure-of-arrays cache of the back TPC segment of every
+   candidate track.
+
+   The cache is built once per event in InitializeEvent from the FGD1 and FGD2
+   "good quality TPC" track groups, in that order, so that the steps can read
+   contiguous columns instead of calling anaUtils::GetTPCBackSegment for every
+   candidate in every toy. Candidate sets refer to a track by its row in the
+   cache (see CandidateSet::GetIndex).
+
+   The varied columns are rewritten by Refresh for each toy, so the toys of an
+   event must be run one after the other while they share the cache.
+
+   The columns are sized for the largest event so far. An event with more than
+   NMAXTPCECALCANDIDATES rows is counted, and the first one is reported, since
+   the candidate sets also have to grow for it.
+*/
+class TPCBackSegmentCache
+{
+public:
+   TPCBackSegmentCache();
+   virtual ~TPCBackSegmentCache(){ }
+
+   /**
+      Rebuilds the cache for an event. The tracker EventBox must already have
+      been filled.
+
+      \param event   The event whose candidate tracks are to be cached.
+      \param det  The detector fiducial volume of the selection. This determines
+                  which of the FGD track groups are cached.
+   */
+   void Build(const AnaEventB& event, const SubDetId::SubDetEnum det);
+
+   /**
+      Re-reads the columns that systematic variations may change from the
+      cached segments. This should be called once per toy, before any step
+      reads the momentum, charge or pull columns.
+   */
+   void Refresh();
+
+   /**
+      Retrieves the row of a track, adding the track to the cache if it was not
+      part of the groups cached by Build.
+
+      \param track   The track to look up.
+      \return  The row of the track.
+   */
+   int FindOrAdd(AnaTrackB* track);
+
+   /**
+      Retrieves the number of rows in the cache.
+
+      \return  The number of cached tracks.
+   */
+   unsigned int GetNumTracks() const { return _nTracks; }
+
+   /**
+      Retrieves the number of rows that hold FGD1 tracks. These are the first
+      rows of the cache and are followed by the FGD2 tracks.
+
+      \return  The number of cached FGD1 tracks.
+   */
+   unsigned int GetNumFGD1Tracks() const { return _nFGD1Tracks; }
+
+   /**
+      Retrieves the number of rows filled by Build, i.e. the FGD1 and FGD2
+      tracks. Rows added later by FindOrAdd follow these.
+
+      \return  The number of cached FGD1 and FGD2 tracks.
+   */
+   unsigned int GetNumFGDTracks() const { return _nFGDTracks; }
+
+   /**
+      Retrieves the number of events, over all caches, with more than
+      NMAXTPCECALCANDIDATES rows.
+
+      \return  The number of events.
+   */
+   static unsigned long GetNumOverflows() { return _nOverflows; }
+
+   /// The cached global tracks
+   std::vector<AnaTrackB*> Track;
+   /// The back TPC segment of each track, or NULL if it has none
+   std::vector<AnaTpcTrack*> Segment;
+
+   /// Momentum of the global track
+   std::vector<Float_t> TrackMomentum;
+   /// Charge of the global track
+   std::vector<Float_t> TrackCharge;
+
+   /// End position of the back TPC segment, one column per coordinate
+   std::vector<Float_t> PositionEnd[3];
+   /// End direction of the back TPC segment, one column per coordinate
+   std::vector<Float_t> DirectionEnd[3];
+   /// Momentum of the back TPC segment
+   std::vector<Float_t> Momentum;
+   /// Charge of the back TPC segment
+   std::vector<Float_t> Charge;
+   /// Number of hits in the back TPC segment
+   std::vector<Int_t> NHits;
+
+   /// Whether the track starts in the fiducial volume of its FGD. Only filled
+   /// for the rows filled by Build. A char column, so that it can be read
+   /// through a pointer.
+   std::vector<char> InFGDFV;
+
+   /// Muon pull of the back TPC segment
+   std::vector<Float_t> Pullmu;
+   /// Electron pull of the back TPC segment
+   std::vector<Float_t> Pullele;
+   /// Pion pull of the back TPC segment
+   std::vector<Float_t> Pullpi;
+   /// Proton pull of the back TPC segment
+   std::vector<Float_t> Pullp;
+
+private:
+   /**
+      Makes room for at least the given number of rows, keeping the rows
+      already filled. Reaching NMAXTPCECALCANDIDATES rows counts the event,
+      and the first time it happens a warning is printed.
+
+      \param size The number of rows.
+   */
+   void Reserve(const unsigned int size);
+
+   /**
+      Fills every column of a row from its track and segment.
+
+      \param row  The row to fill.
+   */
+   void FillRow(const unsigned int row);
+
+   /**
+      Fills the columns that systematic variations may change for a row.
+
+      \param row  The row to fill.
+   */
+   void FillVariedColumns(const unsigned int row);
+
+   unsigned int _nTracks;
+   unsigned int _nFGD1Tracks;
+   unsigned int _nFGDTracks;
+
+   static unsigned long _nOverflows;
+};
+
+#endif
@@ -6,7 +6,8 @@
 #include "baseAnalysis.hxx"
 
 //********************************************************************
-TPCECalAntiMuonSelection::TPCECalAntiMuonSelection(bool forceBreak): SelectionBase(forceBreak) {
+TPCECalAntiMuonSelection::TPCECalAntiMuonSelection(bool forceBreak):
+   TPCECalSelectionBase(forceBreak, "AntiMuon") {
 //********************************************************************
 
 }
@@ -52,11 +53,19 @@ void TPCECalAntiMuonSelection::DefineSteps(){
    AddStep(StepBase::kAction, "Find AntiMuon PID", new FindAntiMuonPIDAction());
 //   AddStep(StepBase::kCut, "Neg Mul", new NegativeMultiplicityCut());
    AddStep(StepBase::kCut, "AntiMuon PID", new AntiMuonPIDCut());
-   AddStep(StepBase::kAction, "Find DS Track",
-      new FindDownstreamTracksAction());
-   AddStep(StepBase::kAction, "Find Barrel Track",
-      new FindBarrelTracksAction());
-   AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   if(ND::params().GetParameterI(
+      "TPCECalSystematicsAnalysis.Selections.UseFusedECalFinder"))
+   {
+      AddStep(StepBase::kAction, "Find ECal Track", new FindECalTracksAction());
+   }
+   else
+   {
+      AddStep(StepBase::kAction, "Find DS Track",
+         new FindDownstreamTracksAction());
+      AddStep(StepBase::kAction, "Find Barrel Track",
+         new FindBarrelTracksAction());
+      AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   }
    
    // Add a split to the trunk with 2 branches.
    AddSplit(2);
@@ -79,44 +88,26 @@ bool FindAntiMuonPIDAction::Apply(AnaEventB& event, ToyBoxB& box) const
    (void)event;
 
    ToyBoxTPCECal* tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
+   TrackCandidateSet& posTracks = tpcECalBox->positiveTracks;
+   _windows.Select(*tpcECalBox->segments, posTracks);
+
+   // Followed by the standard antimuon PID
+   for(unsigned int i = 0; i < posTracks.GetNumEntries(); ++i)
    {
-      AnaTpcTrack* track = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(*i));
-
-      Float_t pullElectron = track->Pullele;
-      Float_t pullMuon = track->Pullmu;
-      
-      if((track->Momentum > 0) &&
-         (pullMuon > -2 && pullMuon < 2) &&
-         (pullElectron > 2 || pullElectron < -1) &&
-         (cutUtils::AntiMuonPIDCut(*(*i))))
-      {
-         tpcECalBox->isAntiMuonLike = true;
-         i++;
-      }
-      else
+      if(posTracks.IsSelected(i) && !cutUtils::AntiMuonPIDCut(*posTracks[i]))
       {
-         tpcECalBox->positiveTracks.erase(i++);
+         posTracks.Reject(i);
       }
    }
+
+   if(posTracks.GetNumSelected() > 0)
+   {
+      tpcECalBox->isAntiMuonLike = true;
+   }
    
    return true;
 }
 
-void TPCECalAntiMuonSelection::InitializeEvent(AnaEventB& event)
-{
-  // Create the appropriate EventBox if it does not exist yet
-  if (!event.EventBoxes[AnaEventB::kEventBoxTracker])
-    event.EventBoxes[AnaEventB::kEventBoxTracker] = new EventBoxTracker();
-  
-  boxUtils::FillTracksWithTPC(event,             GetDetectorFV());
-  boxUtils::FillTracksWithFGD(event,             GetDetectorFV());
-  boxUtils::FillTrajsChargedInTPC(event);
-  boxUtils::FillTrajsChargedInFGDAndNoTPC(event, GetDetectorFV());
-}
-
 bool AntiMuonPIDCut::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    (void) event;
@@ -5,7 +5,8 @@
 #include "EventBoxUtils.hxx"
 #include "baseAnalysis.hxx"
 
-TPCECalElectronSelection::TPCECalElectronSelection(bool forceBreak): SelectionBase(forceBreak)
+TPCECalElectronSelection::TPCECalElectronSelection(bool forceBreak):
+   TPCECalSelectionBase(forceBreak, "Electron")
 {
 }
 
@@ -34,11 +35,19 @@ void TPCECalElectronSelection::DefineSteps()
    AddStep(StepBase::kCut, "TPC Qual", new TPCTrackQualityCut(), true);
    AddStep(StepBase::kAction, "Find e PID", new FindElectronPIDAction());
    AddStep(StepBase::kCut, "e PID", new ElectronPIDCut());
-   AddStep(StepBase::kAction, "Find DS Track",
-      new FindDownstreamTracksAction());
-   AddStep(StepBase::kAction, "Find Barrel Track",
-      new FindBarrelTracksAction());
-   AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   if(ND::params().GetParameterI(
+      "TPCECalSystematicsAnalysis.Selections.UseFusedECalFinder"))
+   {
+      AddStep(StepBase::kAction, "Find ECal Track", new FindECalTracksAction());
+   }
+   else
+   {
+      AddStep(StepBase::kAction, "Find DS Track",
+         new FindDownstreamTracksAction());
+      AddStep(StepBase::kAction, "Find Barrel Track",
+         new FindBarrelTracksAction());
+      AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   }
    
    // Add a split to the trunk with 2 branches.
    AddSplit(2);
@@ -61,46 +70,17 @@ bool FindElectronPIDAction::Apply(AnaEventB& event, ToyBoxB& box) const
    (void)event;
 
    ToyBoxTPCECal* tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+   TrackCandidateSet& negTracks = tpcECalBox->negativeTracks;
+   _windows.Select(*tpcECalBox->segments, negTracks);
 
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
+   if(negTracks.GetNumSelected() > 0)
    {
-      AnaTpcTrack* track = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(*i));
-
-      Float_t pullElectron = track->Pullele;
-      Float_t pullMuon = track->Pullmu;
-      Float_t pullPion = track->Pullpi;
-      
-      if((track->Momentum > 0) &&
-         (pullElectron > -1 && pullElectron < 2) &&
-         (pullMuon < -2.5 || pullMuon > 2.5) &&
-         (pullPion < -2 || pullPion > 2))
-      {
-         tpcECalBox->isElectronLike = true;
-         i++;
-      }
-      else
-      {
-         tpcECalBox->negativeTracks.erase(i++);
-      }
+      tpcECalBox->isElectronLike = true;
    }
    
    return true;
 }
 
-void TPCECalElectronSelection::InitializeEvent(AnaEventB& event)
-{
-  // Create the appropriate EventBox if it does not exist yet
-  if (!event.EventBoxes[AnaEventB::kEventBoxTracker])
-    event.EventBoxes[AnaEventB::kEventBoxTracker] = new EventBoxTracker();
-  
-  boxUtils::FillTracksWithTPC(event,             GetDetectorFV());
-  boxUtils::FillTracksWithFGD(event,             GetDetectorFV());
-  boxUtils::FillTrajsChargedInTPC(event);
-  boxUtils::FillTrajsChargedInFGDAndNoTPC(event, GetDetectorFV());
-}
-
 bool ElectronPIDCut::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    (void) event;
@@ -6,7 +6,8 @@
 #include "baseAnalysis.hxx"
 
 //********************************************************************
-TPCECalMuonSelection::TPCECalMuonSelection(bool forceBreak): SelectionBase(forceBreak) {
+TPCECalMuonSelection::TPCECalMuonSelection(bool forceBreak):
+   TPCECalSelectionBase(forceBreak, "Muon") {
 //********************************************************************
 
 }
@@ -50,11 +51,19 @@ void TPCECalMuonSelection::DefineSteps(){
    AddStep(StepBase::kCut, "External FGD1", new ExternalFGD1lastlayersCut());      
    AddStep(StepBase::kAction, "Find Muon PID", new FindMuonPIDAction());
    AddStep(StepBase::kCut, "Muon PID", new MuonPIDCut());
-   AddStep(StepBase::kAction, "Find DS Track",
-      new FindDownstreamTracksAction());
-   AddStep(StepBase::kAction, "Find Barrel Track",
-      new FindBarrelTracksAction());
-   AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   if(ND::params().GetParameterI(
+      "TPCECalSystematicsAnalysis.Selections.UseFusedECalFinder"))
+   {
+      AddStep(StepBase::kAction, "Find ECal Track", new FindECalTracksAction());
+   }
+   else
+   {
+      AddStep(StepBase::kAction, "Find DS Track",
+         new FindDownstreamTracksAction());
+      AddStep(StepBase::kAction, "Find Barrel Track",
+         new FindBarrelTracksAction());
+      AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   }
    
    // Add a split to the trunk with 2 branches.
    AddSplit(2);
@@ -77,44 +86,28 @@ bool FindMuonPIDAction::Apply(AnaEventB& event, ToyBoxB& box) const
    (void)event;
 
    ToyBoxTPCECal* tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
+   TrackCandidateSet& negTracks = tpcECalBox->negativeTracks;
+   _windows.Select(*tpcECalBox->segments, negTracks);
+
+   // The standard muon PID needs the global track, so is not part of the
+   // window table
+   for(unsigned int i = 0; i < negTracks.GetNumEntries(); ++i)
    {
-      AnaTpcTrack* track = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(*i));
-
-      Float_t pullElectron = track->Pullele;
-      Float_t pullMuon = track->Pullmu;
-      
-      if((track->Momentum > 0) &&
-         (pullMuon > -2 && pullMuon < 2) &&
-         (pullElectron > 2 || pullElectron < -1) &&
-         (cutUtils::MuonPIDCut(*(*i), _prod5Cut)))
-      {
-         tpcECalBox->isMuonLike = true;
-         i++;
-      }
-      else
+      if(negTracks.IsSelected(i) &&
+         !cutUtils::MuonPIDCut(*negTracks[i], _prod5Cut))
       {
-         tpcECalBox->negativeTracks.erase(i++);
+         negTracks.Reject(i);
       }
    }
+
+   if(negTracks.GetNumSelected() > 0)
+   {
+      tpcECalBox->isMuonLike = true;
+   }
    
    return true;
 }
 
-void TPCECalMuonSelection::InitializeEvent(AnaEventB& event)
-{
-  // Create the appropriate EventBox if it does not exist yet
-  if (!event.EventBoxes[AnaEventB::kEventBoxTracker])
-    event.EventBoxes[AnaEventB::kEventBoxTracker] = new EventBoxTracker();
-  
-  boxUtils::FillTracksWithTPC(event,             GetDetectorFV());
-  boxUtils::FillTracksWithFGD(event,             GetDetectorFV());
-  boxUtils::FillTrajsChargedInTPC(event);
-  boxUtils::FillTrajsChargedInFGDAndNoTPC(event, GetDetectorFV());
-}
-
 bool MuonPIDCut::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    (void) event;
@@ -6,7 +6,7 @@
 #include "Parameters.hxx"
 
 //---- Define the class for the new selection, which should inherit from SelectionBase or from another existing selection -------
-class TPCECalMuonSelection: public SelectionBase
+class TPCECalMuonSelection: public TPCECalSelectionBase
 {
 public:
   TPCECalMuonSelection(bool forceBreak=true);
@@ -24,9 +24,6 @@ public:
   /// information to be passed from one step to the next
   ToyBoxB* MakeToyBox() {return new ToyBoxTPCECal();}
 
-  /// Fill the EventBox with the objects needed by this selection
-  void InitializeEvent(AnaEventB& event);
-
   //---- These are optional functions, needed by FITTERS but not by highland2 analyses --------------
 
   bool FillEventSummary(AnaEventB& event, Int_t allCutsPassed[]);
@@ -34,18 +31,23 @@ public:
 };
 
 ///---- Define all steps -------
-class FindMuonPIDAction: public StepBase
+class FindMuonPIDAction: public TPCECalStepBase
 {
 public:
-   FindMuonPIDAction()
+   FindMuonPIDAction(): _windows("Muon")
    {
       _prod5Cut = false;
    }
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
-   StepBase* MakeClone(){ return new FindMuonPIDAction(); }
+   StepBase* MakeClone(){ return new FindMuonPIDAction(*this); }
+   std::string GetConfiguration() const
+   {
+      return _windows.GetConfiguration() + (_prod5Cut ? "Prod5Cut" : "");
+   }
 private:
    bool _prod5Cut;
+   PIDWindowTable _windows;
 };
 
 class MuonPIDCut: public StepBase
@@ -5,7 +5,8 @@
 #include "EventBoxUtils.hxx"
 #include "baseAnalysis.hxx"
 
-TPCECalPositronSelection::TPCECalPositronSelection(bool forceBreak): SelectionBase(forceBreak)
+TPCECalPositronSelection::TPCECalPositronSelection(bool forceBreak):
+   TPCECalSelectionBase(forceBreak, "Positron")
 {
 }
 
@@ -34,11 +35,19 @@ void TPCECalPositronSelection::DefineSteps()
    AddStep(StepBase::kCut, "TPC Qual", new TPCTrackQualityCut(), true);
    AddStep(StepBase::kAction, "Find e+ PID", new FindPositronPIDAction());
    AddStep(StepBase::kCut, "e+ PID", new PositronPIDCut());
-   AddStep(StepBase::kAction, "Find DS Track",
-      new FindDownstreamTracksAction());
-   AddStep(StepBase::kAction, "Find Barrel Track",
-      new FindBarrelTracksAction());
-   AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   if(ND::params().GetParameterI(
+      "TPCECalSystematicsAnalysis.Selections.UseFusedECalFinder"))
+   {
+      AddStep(StepBase::kAction, "Find ECal Track", new FindECalTracksAction());
+   }
+   else
+   {
+      AddStep(StepBase::kAction, "Find DS Track",
+         new FindDownstreamTracksAction());
+      AddStep(StepBase::kAction, "Find Barrel Track",
+         new FindBarrelTracksAction());
+      AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   }
    
    // Add a split to the trunk with 2 branches.
    AddSplit(2);
@@ -61,48 +70,17 @@ bool FindPositronPIDAction::Apply(AnaEventB& event, ToyBoxB& box) const
    (void)event;
 
    ToyBoxTPCECal* tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+   TrackCandidateSet& posTracks = tpcECalBox->positiveTracks;
+   _windows.Select(*tpcECalBox->segments, posTracks);
 
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
+   if(posTracks.GetNumSelected() > 0)
    {
-      AnaTpcTrack* track = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(*i));
-
-      Float_t pullElectron = track->Pullele;
-      Float_t pullMuon = track->Pullmu;
-      Float_t pullPion = track->Pullpi;
-      Float_t pullProton = track->Pullp;
-      
-      if((track->Momentum > 0) &&
-         (pullElectron > -1 && pullElectron < 2) &&
-         (pullMuon < -2.5 || pullMuon > 2.5) &&
-         (pullPion < -2 || pullPion > 2) &&
-         (pullProton < -2.5 || pullProton > 2.5))
-      {
-         tpcECalBox->isPositronLike = true;
-         i++;
-      }
-      else
-      {
-         tpcECalBox->positiveTracks.erase(i++);
-      }
+      tpcECalBox->isPositronLike = true;
    }
    
    return true;
 }
 
-void TPCECalPositronSelection::InitializeEvent(AnaEventB& event)
-{
-  // Create the appropriate EventBox if it does not exist yet
-  if (!event.EventBoxes[AnaEventB::kEventBoxTracker])
-    event.EventBoxes[AnaEventB::kEventBoxTracker] = new EventBoxTracker();
-  
-  boxUtils::FillTracksWithTPC(event,             GetDetectorFV());
-  boxUtils::FillTracksWithFGD(event,             GetDetectorFV());
-  boxUtils::FillTrajsChargedInTPC(event);
-  boxUtils::FillTrajsChargedInFGDAndNoTPC(event, GetDetectorFV());
-}
-
 bool PositronPIDCut::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    (void) event;
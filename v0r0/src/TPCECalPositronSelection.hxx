@@ -6,7 +6,7 @@
 #include "Parameters.hxx"
 
 //---- Define the class for the new selection, which should inherit from SelectionBase or from another existing selection -------
-class TPCECalPositronSelection: public SelectionBase
+class TPCECalPositronSelection: public TPCECalSelectionBase
 {
 public:
   TPCECalPositronSelection(bool forceBreak=true);
@@ -24,9 +24,6 @@ public:
   /// information to be passed from one step to the next
   ToyBoxB* MakeToyBox() {return new ToyBoxTPCECal();}
 
-  /// Fill the EventBox with the objects needed by this selection
-  void InitializeEvent(AnaEventB& event);
-
   //---- These are optional functions, needed by FITTERS but not by highland2 analyses --------------
 
   bool FillEventSummary(AnaEventB& event, Int_t allCutsPassed[]);
@@ -34,12 +31,21 @@ public:
 };
 
 ///---- Define all steps -------
-class FindPositronPIDAction: public StepBase
+class FindPositronPIDAction: public TPCECalStepBase
 {
 public:
+   FindPositronPIDAction(): _windows("Positron")
+   {
+   }
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
-   StepBase* MakeClone(){ return new FindPositronPIDAction(); }
+   StepBase* MakeClone(){ return new FindPositronPIDAction(*this); }
+   std::string GetConfiguration() const
+   {
+      return _windows.GetConfiguration();
+   }
+private:
+   PIDWindowTable _windows;
 };
 
 class PositronPIDCut: public StepBase
@@ -5,7 +5,8 @@
 #include "EventBoxUtils.hxx"
 #include "baseAnalysis.hxx"
 
-TPCECalProtonSelection::TPCECalProtonSelection(bool forceBreak): SelectionBase(forceBreak)
+TPCECalProtonSelection::TPCECalProtonSelection(bool forceBreak):
+   TPCECalSelectionBase(forceBreak, "Proton")
 {
 }
 
@@ -43,11 +44,19 @@ void TPCECalProtonSelection::DefineSteps()
    AddStep(StepBase::kCut, "External FGD1", new ExternalFGD1lastlayersCut());      
    AddStep(StepBase::kAction, "Find Proton PID", new FindProtonPIDAction());
    AddStep(StepBase::kCut, "Proton PID", new ProtonPIDCut());
-   AddStep(StepBase::kAction, "Find DS Track",
-      new FindDownstreamTracksAction());
-   AddStep(StepBase::kAction, "Find Barrel Track",
-      new FindBarrelTracksAction());
-   AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   if(ND::params().GetParameterI(
+      "TPCECalSystematicsAnalysis.Selections.UseFusedECalFinder"))
+   {
+      AddStep(StepBase::kAction, "Find ECal Track", new FindECalTracksAction());
+   }
+   else
+   {
+      AddStep(StepBase::kAction, "Find DS Track",
+         new FindDownstreamTracksAction());
+      AddStep(StepBase::kAction, "Find Barrel Track",
+         new FindBarrelTracksAction());
+      AddStep(StepBase::kAction, "Select Track", new SelectTrackAction());
+   }
    
    // Add a split to the trunk with 2 branches.
    AddSplit(2);
@@ -65,45 +74,27 @@ void TPCECalProtonSelection::DefineSteps()
    SetPreSelectionAccumLevel(2);
 }
 
-void TPCECalProtonSelection::InitializeEvent(AnaEventB& event)
-{
-  // Create the appropriate EventBox if it does not exist yet
-  if (!event.EventBoxes[AnaEventB::kEventBoxTracker])
-    event.EventBoxes[AnaEventB::kEventBoxTracker] = new EventBoxTracker();
-  
-  boxUtils::FillTracksWithTPC(event,             GetDetectorFV());
-  boxUtils::FillTracksWithFGD(event,             GetDetectorFV());
-  boxUtils::FillTrajsChargedInTPC(event);
-  boxUtils::FillTrajsChargedInFGDAndNoTPC(event, GetDetectorFV());
-}
-
 bool FindProtonPIDAction::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    (void)event;
 
    ToyBoxTPCECal* tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
-   {
-      AnaTpcTrack* track = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(*i));
+   TrackCandidateSet& posTracks = tpcECalBox->positiveTracks;
+   _windows.Select(*tpcECalBox->segments, posTracks);
 
-      Float_t pullElectron = track->Pullele;
-      Float_t pullProton = track->Pullp;
-      
-      if((track->Momentum > 0) &&
-         (pullElectron < -1 || pullElectron > 2) &&
-         (pullProton > -2 && pullProton < 2) &&
-         cutUtils::ProtonPIDCut(*(*i)))
-      {
-         tpcECalBox->isProtonLike = true;
-         i++;
-      }
-      else
+   // Followed by the standard proton PID
+   for(unsigned int i = 0; i < posTracks.GetNumEntries(); ++i)
+   {
+      if(posTracks.IsSelected(i) && !cutUtils::ProtonPIDCut(*posTracks[i]))
       {
-         tpcECalBox->positiveTracks.erase(i++);
+         posTracks.Reject(i);
       }
    }
+
+   if(posTracks.GetNumSelected() > 0)
+   {
+      tpcECalBox->isProtonLike = true;
+   }
    
    return true;
 }
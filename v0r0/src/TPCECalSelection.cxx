@@ -1,23 +1,368 @@
+#include <algorithm>
+#include <sstream>
+#include <utility>
+#include <vector>
 #include <boost/fusion/iterator/next.hpp>
 #include "TPCECalSelection.hxx"
 #include "baseSelection.hxx"
 #include "CutUtils.hxx"
 #include "SubDetId.hxx"
 #include "EventBoxUtils.hxx"
+#include "EventBoxTPCECal.hxx"
+#include "PreselectionIndex.hxx"
 #include "baseAnalysis.hxx"
 
+/// Working arrays of the batch kernels. The steps of an event are applied one
+/// at a time, so they share one of each.
+static ScratchBuffer<int> scratchRows;
+static ScratchBuffer<unsigned int> scratchSlots;
+static ScratchBuffer<bool> scratchPass;
+static ScratchBuffer<unsigned char> scratchRegions;
+
+/**
+   Lists the segment cache rows of the selected candidates of a set, so that
+   they can be passed to the column kernels.
+
+   \param tracks  The candidates.
+   \param rows    Set to the row of each selected candidate, in scratchRows.
+   \param slots   Set to the slot of each selected candidate in the set, in
+                  scratchSlots.
+   \return  The number of selected candidates.
+*/
+static unsigned int GatherSelectedRows(const TrackCandidateSet& tracks,
+   int*& rows, unsigned int*& slots)
+{
+   rows = scratchRows.Get(tracks.GetNumEntries());
+   slots = scratchSlots.Get(tracks.GetNumEntries());
+   unsigned int n = 0;
+   for(unsigned int i = 0; i < tracks.GetNumEntries(); ++i)
+   {
+      if(tracks.IsSelected(i))
+      {
+         rows[n] = tracks.GetIndex(i);
+         slots[n] = i;
+         ++n;
+      }
+   }
+
+   return n;
+}
+
+/**
+   Finds the varied quantities a step reads.
+
+   \param step The step.
+   \return  The StepDependencyEnum flags of the quantities. Steps that do not
+            declare them are assumed to read every varied quantity.
+*/
+static unsigned int GetStepDependencies(StepBase* step)
+{
+   TPCECalStepBase* tpcECalStep = dynamic_cast<TPCECalStepBase*>(step);
+   if(tpcECalStep)
+   {
+      return tpcECalStep->GetDependencies();
+   }
+
+   // The event quality flags are not varied
+   if(dynamic_cast<EventQualityCut*>(step))
+   {
+      return kNoDependencies;
+   }
+
+   return kDependsOnAll;
+}
+
+TPCECalSelectionBase::TPCECalSelectionBase(bool forceBreak,
+   const std::string& name): SelectionBase(forceBreak), _profileName(name),
+   _memoising(ND::params().GetParameterI(
+      "TPCECalSystematicsAnalysis.Selections.MemoiseInvariantSteps")),
+   _checkpoint(StepCheckpointer::Get().Create(name)), _stepKey(0),
+   _nTrunkSteps(0)
+{
+}
+
+void TPCECalSelectionBase::InitializeEvent(AnaEventB& event)
+{
+   // The EventBox is shared by all the TPC/ECal selections, so only the first
+   // of them to see this event does the filling
+   EventBoxTPCECal::Create(event).Fill(event, GetDetectorFV());
+}
+
+void TPCECalSelectionBase::AddStep(StepBase::TypeEnum type,
+   const std::string& title, StepBase* step, bool cut_break)
+{
+   // Steps resumed from a checkpoint are replayed, so need no memo
+   _stepKey = StepCheckpoint::GetStepKey(_stepKey, title, step);
+   const bool resumed = _checkpoint && _checkpoint->CanResume(_stepKey);
+
+   // Memoise steps until the first one that reads a varied quantity
+   _memoising = _memoising && GetStepDependencies(step) == kNoDependencies;
+   if(_memoising && !resumed)
+   {
+      step = _memo.Wrap(step, _stepKey);
+   }
+   if(_checkpoint)
+   {
+      step = _checkpoint->Wrap(step, _stepKey, title);
+   }
+   if(++_nTrunkSteps == NPRESELECTIONSTEPS)
+   {
+      step = PreselectionIndex::Get().Wrap(step);
+   }
+
+   SelectionBase::AddStep(type, title,
+      StepProfiler::Get().Wrap(step, _profileName, -1, title), cut_break);
+}
+
+void TPCECalSelectionBase::AddStep(Int_t branch, StepBase::TypeEnum type,
+   const std::string& title, StepBase* step, bool cut_break)
+{
+   SelectionBase::AddStep(branch, type, title,
+      StepProfiler::Get().Wrap(step, _profileName, branch, title), cut_break);
+}
+
+template <class DSGeometry, class BarrelGeometry>
+ECalAcceptanceKernelT<DSGeometry, BarrelGeometry>::ECalAcceptanceKernelT():
+   ECalAcceptanceKernelT(DSGeometry::TpcAngleMax, BarrelGeometry::TpcAngleMin,
+      BarrelGeometry::TpcAzimuthAbs)
+{
+}
+
+template <class DSGeometry, class BarrelGeometry>
+ECalAcceptanceKernelT<DSGeometry, BarrelGeometry>::ECalAcceptanceKernelT(
+   const double dsAngleMax, const double barrelAngleMin,
+   const double barrelAzimuthAbs)
+{
+   // The DS and polar limits are below 90 degrees and the azimuthal limit is
+   // above it, which fixes the sign of each cosine in the tests below.
+   double cosDSAngleMax = TMath::Cos(dsAngleMax * TMath::DegToRad());
+   double cosBarrelAngleMin = TMath::Cos(barrelAngleMin * TMath::DegToRad());
+   double cosBarrelAzimuthAbs = TMath::Cos(barrelAzimuthAbs *
+      TMath::DegToRad());
+
+   _cos2DSAngleMax = cosDSAngleMax * cosDSAngleMax;
+   _cos2BarrelAngleMin = cosBarrelAngleMin * cosBarrelAngleMin;
+   _cos2BarrelAzimuthAbs = cosBarrelAzimuthAbs * cosBarrelAzimuthAbs;
+}
+
+template <class DSGeometry, class BarrelGeometry>
+void ECalAcceptanceKernelT<DSGeometry, BarrelGeometry>::Classify(
+   const TPCBackSegmentCache& segments, const int* rows, const unsigned int n,
+   unsigned char* regions) const
+{
+   const Float_t* posX = segments.PositionEnd[0].data();
+   const Float_t* posY = segments.PositionEnd[1].data();
+   const Float_t* posZ = segments.PositionEnd[2].data();
+   const Float_t* dirX = segments.DirectionEnd[0].data();
+   const Float_t* dirY = segments.DirectionEnd[1].data();
+   const Float_t* dirZ = segments.DirectionEnd[2].data();
+
+   // Branch-free, so the loop can be vectorised. Any NaN makes the relevant
+   // comparisons false, as it did for the angles computed from TVector3.
+   for(unsigned int i = 0; i < n; ++i)
+   {
+      const int k = rows[i];
+      const double x = posX[k];
+      const double y = posY[k];
+      const double z = posZ[k];
+      const double dx = dirX[k];
+      const double dy = dirY[k];
+      const double dz = dirZ[k];
+      const double transverse2 = dx * dx + dy * dy;
+      const double mag2 = transverse2 + dz * dz;
+
+      // Angle from z of at most TpcAngleMax. TVector3::Angle returns 0 for a
+      // zero vector, so that passes.
+      const bool inDSFace = (x >= DSGeometry::TpcXMin) &
+         (x <= DSGeometry::TpcXMax) & (y >= DSGeometry::TpcYMin) &
+         (y <= DSGeometry::TpcYMax) & (z >= DSGeometry::TpcZMin);
+      const bool dsAngle = (mag2 == 0) |
+         ((dz > 0) & (dz * dz >= _cos2DSAngleMax * mag2));
+
+      // Outside the TPC in x or y, but within the barrel in z. A NaN y still
+      // passes if x alone is outside, as it always has.
+      const bool outsideTPC = (x < BarrelGeometry::TpcXMin) |
+         (x > BarrelGeometry::TpcXMax) | (y < BarrelGeometry::TpcYMin) |
+         (y > BarrelGeometry::TpcYMax);
+      const bool inBarrelFace = !std::isnan(x) & outsideTPC &
+         (z >= BarrelGeometry::TpcZMin) & (z <= BarrelGeometry::TpcZMax);
+
+      // Angle from z of at least TpcAngleMin. A zero vector gives
+      // acos(0), i.e. 90 degrees, so that passes.
+      const bool barrelPolar = (dz <= 0) |
+         (dz * dz <= _cos2BarrelAngleMin * mag2);
+
+      // Azimuth from y of at most TpcAzimuthAbs. atan(x / y) is
+      // undefined when both are zero and is 0 whenever x is zero, and only
+      // directions with negative y can exceed the limit.
+      const bool barrelAzimuth = !std::isnan(dx) & !std::isnan(dy) &
+         (transverse2 != 0) & ((dx == 0) | (dy >= 0) |
+         (dy * dy <= _cos2BarrelAzimuthAbs * transverse2));
+
+      regions[i] = ((inDSFace & dsAngle) ? kDownstream : kNoECal) |
+         ((inBarrelFace & barrelPolar & barrelAzimuth) ? kBarrel : kNoECal);
+   }
+}
+
+template <class DSGeometry, class BarrelGeometry>
+std::string
+   ECalAcceptanceKernelT<DSGeometry, BarrelGeometry>::GetConfiguration()
+{
+   std::ostringstream config;
+   config << "DS=" << DSGeometry::TpcXMin << "," << DSGeometry::TpcXMax <<
+      "," << DSGeometry::TpcYMin << "," << DSGeometry::TpcYMax << "," <<
+      DSGeometry::TpcZMin << "," << DSGeometry::TpcAngleMax << ";Barrel=" <<
+      BarrelGeometry::TpcXMin << "," << BarrelGeometry::TpcXMax << "," <<
+      BarrelGeometry::TpcYMin << "," << BarrelGeometry::TpcYMax << "," <<
+      BarrelGeometry::TpcZMin << "," << BarrelGeometry::TpcZMax << "," <<
+      BarrelGeometry::TpcAzimuthAbs << "," << BarrelGeometry::TpcAngleMin;
+
+   return config.str();
+}
+
+template class ECalAcceptanceKernelT<DS, Barrel>;
+
+PIDWindowTable::PIDWindowTable(const std::string& species)
+{
+   const char* pullNames[kNPulls] = {"Pullmu", "Pullele", "Pullpi", "Pullp"};
+   for(int j = 0; j < kNPulls; ++j)
+   {
+      std::string name = "TPCECalSystematicsAnalysis.PID." + species + "." +
+         pullNames[j] + ".";
+      _mode[j] = ND::params().GetParameterI(name + "Mode");
+      if(_mode[j] != kIgnore)
+      {
+         _min[j] = ND::params().GetParameterD(name + "Min");
+         _max[j] = ND::params().GetParameterD(name + "Max");
+      }
+      else
+      {
+         _min[j] = 0;
+         _max[j] = 0;
+      }
+   }
+}
+
+void PIDWindowTable::Evaluate(const TPCBackSegmentCache& segments,
+   const int* rows, const unsigned int n, bool* pass) const
+{
+   const Float_t* pulls[kNPulls] = {segments.Pullmu.data(),
+      segments.Pullele.data(), segments.Pullpi.data(), segments.Pullp.data()};
+   EvaluateColumns(segments.Momentum.data(), pulls, rows, n, pass);
+}
+
+void PIDWindowTable::EvaluateColumns(const Float_t* momentum,
+   const Float_t* const* pulls, const int* rows, const unsigned int n,
+   bool* pass) const
+{
+   // Branch-free, so the loop can be vectorised. A NaN pull fails both inside
+   // and outside windows, as it did in the original comparisons.
+   for(unsigned int i = 0; i < n; ++i)
+   {
+      const int k = rows[i];
+      bool ok = momentum[k] > 0;
+      for(int j = 0; j < kNPulls; ++j)
+      {
+         const double pull = pulls[j][k];
+         const bool inside = (pull > _min[j]) & (pull < _max[j]);
+         const bool outside = (pull < _min[j]) | (pull > _max[j]);
+         ok &= (_mode[j] == kIgnore) | ((_mode[j] == kInside) & inside) |
+            ((_mode[j] == kOutside) & outside);
+      }
+      pass[i] = ok;
+   }
+}
+
+unsigned int PIDWindowTable::Select(const TPCBackSegmentCache& segments,
+   TrackCandidateSet& tracks) const
+{
+   int* rows = nullptr;
+   unsigned int* slots = nullptr;
+   const unsigned int n = GatherSelectedRows(tracks, rows, slots);
+
+   bool* pass = scratchPass.Get(n);
+   Evaluate(segments, rows, n, pass);
+
+   for(unsigned int j = 0; j < n; ++j)
+   {
+      if(!pass[j])
+      {
+         tracks.Reject(slots[j]);
+      }
+   }
+
+   return tracks.GetNumSelected();
+}
+
+std::string PIDWindowTable::GetConfiguration() const
+{
+   std::ostringstream config;
+   for(int j = 0; j < kNPulls; ++j)
+   {
+      config << "Mode=" << int(_mode[j]) << ",Min=" << _min[j] << ",Max=" <<
+         _max[j] << ";";
+   }
+
+   return config.str();
+}
+
+/**
+   Finds the highest momentum selected candidates whose back TPC segments
+   point into the downstream and barrel ECals, in a single pass.
+
+   \param acceptance The kernel used to classify the candidates.
+   \param segments   The segment cache of the current event.
+   \param tracks  The candidates to search.
+   \param dsMomentum The momentum to beat in the downstream ECal. Updated if a
+                     track is found.
+   \param dsTrack Set to the highest momentum downstream track found, if any.
+                  NULL to skip the downstream ECal.
+   \param barrelMomentum  As dsMomentum, for the barrel ECal.
+   \param barrelTrack  As dsTrack, for the barrel ECal.
+*/
+static void FindHighestMomentumInRegions(
+   const ECalAcceptanceKernel& acceptance, const TPCBackSegmentCache& segments,
+   const TrackCandidateSet& tracks, Float_t& dsMomentum, AnaTrackB** dsTrack,
+   Float_t& barrelMomentum, AnaTrackB** barrelTrack)
+{
+   int* rows = nullptr;
+   unsigned int* slots = nullptr;
+   const unsigned int n = GatherSelectedRows(tracks, rows, slots);
+
+   unsigned char* regions = scratchRegions.Get(n);
+   acceptance.Classify(segments, rows, n, regions);
+
+   for(unsigned int j = 0; j < n; ++j)
+   {
+      const Float_t momentum = segments.TrackMomentum[rows[j]];
+      if(dsTrack && (regions[j] & ECalAcceptanceKernel::kDownstream) &&
+         momentum > dsMomentum)
+      {
+         dsMomentum = momentum;
+         *dsTrack = tracks[slots[j]];
+      }
+      if(barrelTrack && (regions[j] & ECalAcceptanceKernel::kBarrel) &&
+         momentum > barrelMomentum)
+      {
+         barrelMomentum = momentum;
+         *barrelTrack = tracks[slots[j]];
+      }
+   }
+}
+
 bool NegativeMultiplicityCut::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    (void)event;
 
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   tpcECalBox->negativeTracks.clear();
+   tpcECalBox->negativeTracks.Clear();
    if(tpcECalBox->HMtrack && (tpcECalBox->HMNtrack == tpcECalBox->HMtrack))
    {
-      tpcECalBox->negativeTracks.push_back(tpcECalBox->HMNtrack);
+      tpcECalBox->AddCandidate(tpcECalBox->negativeTracks,
+         tpcECalBox->HMNtrack);
    }
 
-   return tpcECalBox->negativeTracks.size() > 0;
+   return tpcECalBox->negativeTracks.GetNumSelected() > 0;
 }
 
 bool PositiveMultiplicityCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -25,13 +370,14 @@ bool PositiveMultiplicityCut::Apply(AnaEventB& event, ToyBoxB& box) const
    (void)event;
 
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   tpcECalBox->positiveTracks.clear();
+   tpcECalBox->positiveTracks.Clear();
    if(tpcECalBox->HMtrack && (tpcECalBox->HMPtrack == tpcECalBox->HMtrack))
    {
-      tpcECalBox->positiveTracks.push_back(tpcECalBox->HMPtrack);
+      tpcECalBox->AddCandidate(tpcECalBox->positiveTracks,
+         tpcECalBox->HMPtrack);
    }
 
-   return tpcECalBox->positiveTracks.size() > 0;
+   return tpcECalBox->positiveTracks.GetNumSelected() > 0;
 }
 
 bool FindNegativeLeadingTracksAction::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -43,10 +389,11 @@ bool FindNegativeLeadingTracksAction::Apply(AnaEventB& event, ToyBoxB& box) cons
 
    for(int i = 0; i < tpcECalBox->nNegativeTPCtracks; ++i)
    {
-      tpcECalBox->negativeTracks.push_back(tpcECalBox->NegativeTPCtracks[i]);
+      tpcECalBox->AddCandidate(tpcECalBox->negativeTracks,
+         tpcECalBox->NegativeTPCtracks[i]);
    }
 
-   return tpcECalBox->negativeTracks.size() > 0;
+   return tpcECalBox->negativeTracks.GetNumSelected() > 0;
 }
 
 bool FindPositiveLeadingTracksAction::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -58,7 +405,8 @@ bool FindPositiveLeadingTracksAction::Apply(AnaEventB& event, ToyBoxB& box) cons
 
    for(int i = 0; i < tpcECalBox->nPositiveTPCtracks; ++i)
    {
-      tpcECalBox->positiveTracks.push_back(tpcECalBox->PositiveTPCtracks[i]);
+      tpcECalBox->AddCandidate(tpcECalBox->positiveTracks,
+         tpcECalBox->PositiveTPCtracks[i]);
    }
 
    return true;
@@ -68,22 +416,25 @@ bool FindHighestMomentumNegativeTrackAction::Apply(AnaEventB& event, ToyBoxB& bo
 {
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
+   const Float_t* momentum = tpcECalBox->segments->TrackMomentum.data();
+   TrackCandidateSet& tracks = tpcECalBox->negativeTracks;
    Float_t highestMomentum = 0;
-   AnaTrackB* hmTrack = nullptr;
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
+   int hmSlot = -1;
+   for(unsigned int i = 0; i < tracks.GetNumEntries(); ++i)
    {
-      if((*i)->Momentum > highestMomentum)
+      if(tracks.IsSelected(i) && momentum[tracks.GetIndex(i)] > highestMomentum)
       {
-         highestMomentum = (*i)->Momentum;
-         hmTrack = *i;
+         highestMomentum = momentum[tracks.GetIndex(i)];
+         hmSlot = i;
       }
-      i++;
    }
-   tpcECalBox->negativeTracks.clear();
-   if(hmTrack)
+   if(hmSlot >= 0)
    {
-      tpcECalBox->negativeTracks.push_back(hmTrack);
+      tracks.KeepOnly(hmSlot);
+   }
+   else
+   {
+      tracks.Clear();
    }
 
    return true;
@@ -93,22 +444,25 @@ bool FindHighestMomentumPositiveTrackAction::Apply(AnaEventB& event, ToyBoxB& bo
 {
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
+   const Float_t* momentum = tpcECalBox->segments->TrackMomentum.data();
+   TrackCandidateSet& tracks = tpcECalBox->positiveTracks;
    Float_t highestMomentum = 0;
-   AnaTrackB* hmTrack = nullptr;
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
+   int hmSlot = -1;
+   for(unsigned int i = 0; i < tracks.GetNumEntries(); ++i)
    {
-      if((*i)->Momentum > highestMomentum)
+      if(tracks.IsSelected(i) && momentum[tracks.GetIndex(i)] > highestMomentum)
       {
-         highestMomentum = (*i)->Momentum;
-         hmTrack = *i;
+         highestMomentum = momentum[tracks.GetIndex(i)];
+         hmSlot = i;
       }
-      i++;
    }
-   tpcECalBox->positiveTracks.clear();
-   if(hmTrack)
+   if(hmSlot >= 0)
    {
-      tpcECalBox->positiveTracks.push_back(hmTrack);
+      tracks.KeepOnly(hmSlot);
+   }
+   else
+   {
+      tracks.Clear();
    }
 
    return true;
@@ -131,8 +485,16 @@ bool MultiplicityCut::Apply(AnaEventB& event, ToyBoxB& box) const{
   
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
-   return (tpcECalBox->fgd1Tracks.size() >= minimumTracks ||
-      tpcECalBox->fgd2Tracks.size() >= minimumTracks);
+   return (tpcECalBox->fgd1Tracks.GetNumSelected() >= minimumTracks ||
+      tpcECalBox->fgd2Tracks.GetNumSelected() >= minimumTracks);
+}
+
+std::string MultiplicityCut::GetConfiguration() const
+{
+   std::ostringstream config;
+   config << "MinimumTracks=" << minimumTracks;
+
+   return config.str();
 }
 
 bool TPCTrackQualityCut::Apply(AnaEventB& event, ToyBoxB& box) const{
@@ -140,119 +502,140 @@ bool TPCTrackQualityCut::Apply(AnaEventB& event, ToyBoxB& box) const{
    (void)event;
   
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
+   TrackCandidateSet* sets[2] = {&tpcECalBox->negativeTracks,
+      &tpcECalBox->positiveTracks};
+   for(int s = 0; s < 2; ++s)
    {
-      AnaTpcTrack* track = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(*i));
-
-      if(track->NHits < TPC::MinimumNodes)
+      TrackCandidateSet& tracks = *sets[s];
+      int* rows = nullptr;
+      unsigned int* slots = nullptr;
+      const unsigned int n = GatherSelectedRows(tracks, rows, slots);
+
+      bool* pass = scratchPass.Get(n);
+      Evaluate(*tpcECalBox->segments, rows, n, pass);
+      for(unsigned int j = 0; j < n; ++j)
       {
-         tpcECalBox->negativeTracks.erase(i++);
-      }
-      else
-      {
-         i++;
+         if(!pass[j])
+         {
+            tracks.Reject(slots[j]);
+         }
       }
    }
 
-   i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
-   {
-      std::list<AnaTrackB*>::iterator j = tpcECalBox->positiveTracks.end();
-      AnaTpcTrack* track = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(*i));
+   return (tpcECalBox->negativeTracks.GetNumSelected() > 0 ||
+      tpcECalBox->positiveTracks.GetNumSelected() > 0);
+}
 
-      if(track->NHits < TPC::MinimumNodes)
-      {
-         tpcECalBox->positiveTracks.erase(i++);
-      }
-      else
-      {
-         i++;
-      }
-   }
+std::string TPCTrackQualityCut::GetConfiguration() const
+{
+   std::ostringstream config;
+   config << "MinimumNodes=" << TPC::MinimumNodes;
 
-   return (tpcECalBox->negativeTracks.size() > 0 ||
-      tpcECalBox->positiveTracks.size() > 0);
+   return config.str();
+}
+
+void TPCTrackQualityCut::Evaluate(const TPCBackSegmentCache& segments,
+   const int* rows, const unsigned int n, bool* pass)
+{
+   const Int_t* nHits = segments.NHits.data();
+   for(unsigned int i = 0; i < n; ++i)
+   {
+      pass[i] = nHits[rows[i]] >= TPC::MinimumNodes;
+   }
 }
 
 bool ExternalVetoCut::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
+
+   // The veto track is searched for in the track groups of the EventBox
+   EventBoxTPCECal* eventBox = &EventBoxTPCECal::Get(event);
+   eventBox->FillGroups(event, EventBoxTPCECal::kFGDGroups);
+
+   TrackCandidateSet& negTracks = tpcECalBox->negativeTracks;
+   for(unsigned int i = 0; i < negTracks.GetNumEntries(); ++i)
    {
-      AnaTrackB* track = *i;
+      if(!negTracks.IsSelected(i))
+      {
+         continue;
+      }
+      AnaTrackB* track = negTracks[i];
 
       if(!cutUtils::ExternalVetoCut(*track,
          cutUtils::FindVetoTrack(event, *track)))
       {
-         tpcECalBox->negativeTracks.erase(i++);
-      }
-      else
-      {
-         i++;
+         negTracks.Reject(i);
       }
    }
 
-   i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
+   TrackCandidateSet& posTracks = tpcECalBox->positiveTracks;
+   for(unsigned int i = 0; i < posTracks.GetNumEntries(); ++i)
    {
-      AnaTrackB* track = *i;
+      if(!posTracks.IsSelected(i))
+      {
+         continue;
+      }
+      AnaTrackB* track = posTracks[i];
 
       if(!cutUtils::ExternalVetoCut(*track,
          cutUtils::FindVetoTrack(event, *track)))
       {
-         tpcECalBox->positiveTracks.erase(i++);
-      }
-      else
-      {
-         i++;
+         posTracks.Reject(i);
       }
    }
 
-   return (tpcECalBox->negativeTracks.size() > 0 ||
-      tpcECalBox->positiveTracks.size() > 0);
+   return (negTracks.GetNumSelected() > 0 || posTracks.GetNumSelected() > 0);
 }
 
 bool ExternalFGD1lastlayersCut::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
-   {
-      AnaTrackB* track = *i;
 
-      if(cutUtils::FindFGDOOFVtrack(event, *track, tpcECalBox->DetectorFV) ||
-         !(track->PositionStart[2] < 425))
+   // The out of FV FGD tracks are searched for in the FGD track groups
+   EventBoxTPCECal* eventBox = &EventBoxTPCECal::Get(event);
+   eventBox->FillGroups(event, EventBoxTPCECal::kFGDGroups);
+
+   TrackCandidateSet& negTracks = tpcECalBox->negativeTracks;
+   for(unsigned int i = 0; i < negTracks.GetNumEntries(); ++i)
+   {
+      if(!negTracks.IsSelected(i))
       {
-         tpcECalBox->negativeTracks.erase(i++);
+         continue;
       }
-      else
+      AnaTrackB* track = negTracks[i];
+
+      if(cutUtils::FindFGDOOFVtrack(event, *track, tpcECalBox->DetectorFV) ||
+         !(track->PositionStart[2] < MaxStartZ))
       {
-         i++;
+         negTracks.Reject(i);
       }
    }
 
-   i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
+   TrackCandidateSet& posTracks = tpcECalBox->positiveTracks;
+   for(unsigned int i = 0; i < posTracks.GetNumEntries(); ++i)
    {
-      AnaTrackB* track = *i;
-
-      if(cutUtils::FindFGDOOFVtrack(event, *track, tpcECalBox->DetectorFV) ||
-         !(track->PositionStart[2] < 425))
+      if(!posTracks.IsSelected(i))
       {
-         tpcECalBox->positiveTracks.erase(i++);
+         continue;
       }
-      else
+      AnaTrackB* track = posTracks[i];
+
+      if(cutUtils::FindFGDOOFVtrack(event, *track, tpcECalBox->DetectorFV) ||
+         !(track->PositionStart[2] < MaxStartZ))
       {
-         i++;
+         posTracks.Reject(i);
       }
    }
 
-   return (tpcECalBox->negativeTracks.size() > 0 ||
-      tpcECalBox->positiveTracks.size() > 0);
+   return (negTracks.GetNumSelected() > 0 || posTracks.GetNumSelected() > 0);
+}
+
+std::string ExternalFGD1lastlayersCut::GetConfiguration() const
+{
+   std::ostringstream config;
+   config << "MaxStartZ=" << MaxStartZ;
+
+   return config.str();
 }
 
 bool FindDownstreamTracksAction::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -260,79 +643,16 @@ bool FindDownstreamTracksAction::Apply(AnaEventB& event, ToyBoxB& box) const
    (void) event;
 
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+   const TPCBackSegmentCache* segments = tpcECalBox->segments;
 
-   int count = 0;
    Float_t highestMomentum = 0;
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
-   {
-      AnaTrackB* track = *i;
-
-      AnaTpcTrack* backTpc = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(track));
-      TVector3 pos = utils::ArrayToTVector3(backTpc->PositionEnd);
-
-      if(std::isnan(pos.X()) || !(
-         (pos.X() >= DS::TpcXMin && pos.X() <= DS::TpcXMax) &&
-         (pos.Y() >= DS::TpcYMin && pos.Y() <= DS::TpcYMax) &&
-         (pos.Z() >= DS::TpcZMin)))
-      {
-         i++;
-         continue;
-      }
-
-      TVector3 dir = utils::ArrayToTVector3(backTpc->DirectionEnd);
-      TVector3 zdir(0.0, 0.0, 1.0);
-      double tpcBackAngleFromZ = TMath::RadToDeg() * dir.Unit().Angle(zdir);
-      if(std::isnan(dir.X()) || !(tpcBackAngleFromZ <= DS::TpcAngleMax))
-      {
-         i++;
-         continue;
-      }
-
-      if(track->Momentum > highestMomentum)
-      {
-         highestMomentum = track->Momentum;
-         tpcECalBox->downstreamTrack = track;
-         count++;
-      }
-      i++;
-   }
-
-   i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
-   {
-      AnaTrackB* track = *i;
-
-      AnaTpcTrack* backTpc = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(track));
-      TVector3 pos = utils::ArrayToTVector3(backTpc->PositionEnd);
-
-      if(std::isnan(pos.X()) || !(
-         (pos.X() >= DS::TpcXMin && pos.X() <= DS::TpcXMax) &&
-         (pos.Y() >= DS::TpcYMin && pos.Y() <= DS::TpcYMax) &&
-         (pos.Z() >= DS::TpcZMin)))
-      {
-         i++;
-         continue;
-      }
-
-      TVector3 dir = utils::ArrayToTVector3(backTpc->DirectionEnd);
-      TVector3 zdir(0.0, 0.0, 1.0);
-      double tpcBackAngleFromZ = TMath::RadToDeg() * dir.Unit().Angle(zdir);
-      if(std::isnan(dir.X()) || !(tpcBackAngleFromZ <= DS::TpcAngleMax))
-      {
-         i++;
-         continue;
-      }
-
-      if(track->Momentum > highestMomentum)
-      {
-         highestMomentum = track->Momentum;
-         tpcECalBox->downstreamTrack = track;
-      }
-      i++;
-   }
+   Float_t unused = 0;
+   FindHighestMomentumInRegions(_acceptance, *segments,
+      tpcECalBox->negativeTracks, highestMomentum, &tpcECalBox->downstreamTrack,
+      unused, nullptr);
+   FindHighestMomentumInRegions(_acceptance, *segments,
+      tpcECalBox->positiveTracks, highestMomentum, &tpcECalBox->downstreamTrack,
+      unused, nullptr);
 
    return true;
 }
@@ -351,107 +671,16 @@ bool FindBarrelTracksAction::Apply(AnaEventB& event, ToyBoxB& box) const
    (void) event;
 
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+   const TPCBackSegmentCache* segments = tpcECalBox->segments;
 
-   int count = 0;
    Float_t highestMomentum = 0;
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
-   {
-      AnaTrackB* track = *i;
-      AnaTpcTrack* backTpc = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(track));
-      TVector3 pos = utils::ArrayToTVector3(backTpc->PositionEnd);
-
-      if(std::isnan(pos.X()) || !(
-         ((pos.X() < Barrel::TpcXMin) || (pos.X() > Barrel::TpcXMax) ||
-         (pos.Y() < Barrel::TpcYMin) || (pos.Y() > Barrel::TpcYMax)) &&
-         (pos.Z() >= Barrel::TpcZMin && pos.Z() <= Barrel::TpcZMax)))
-      {
-         i++;
-         continue;
-      }
-
-      TVector3 dir = utils::ArrayToTVector3(backTpc->DirectionEnd);
-      TVector3 zdir(0.0, 0.0, 1.0);
-      double tpcBackAzimuth = TMath::RadToDeg() * TMath::ATan(dir.X() / dir.Y());
-
-      if(dir.X() > 0 && dir.Y() < 0)
-      {
-         tpcBackAzimuth += 180;
-      }
-      else if(dir.X() < 0 && dir.Y() < 0)
-      {
-         tpcBackAzimuth -= 180;
-      }
-
-      double tpcBackAngleFromZ = dir.Unit().Dot(zdir);
-      tpcBackAngleFromZ = TMath::RadToDeg() * TMath::ACos(tpcBackAngleFromZ);
-
-      if(std::isnan(dir.X()) || !(
-         (tpcBackAngleFromZ >= Barrel::TpcAngleMin) &&
-         (fabs(tpcBackAzimuth) <= Barrel::TpcAzimuthAbs)))
-      {
-         i++;
-         continue;
-      }
-
-      if(track->Momentum > highestMomentum)
-      {
-         highestMomentum = track->Momentum;
-         tpcECalBox->barrelTrack = track;
-         count++;
-      }
-      i++;
-   }
-
-   i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
-   {
-      AnaTrackB* track = *i;
-      AnaTpcTrack* backTpc = static_cast<AnaTpcTrack*>(
-         anaUtils::GetTPCBackSegment(track));
-      TVector3 pos = utils::ArrayToTVector3(backTpc->PositionEnd);
-
-      if(std::isnan(pos.X()) || !(
-         ((pos.X() < Barrel::TpcXMin) || (pos.X() > Barrel::TpcXMax) ||
-         (pos.Y() < Barrel::TpcYMin) || (pos.Y() > Barrel::TpcYMax)) &&
-         (pos.Z() >= Barrel::TpcZMin && pos.Z() <= Barrel::TpcZMax)))
-      {
-         i++;
-         continue;
-      }
-
-      TVector3 dir = utils::ArrayToTVector3(backTpc->DirectionEnd);
-      TVector3 zdir(0.0, 0.0, 1.0);
-      double tpcBackAzimuth = TMath::RadToDeg() * TMath::ATan(dir.X() / dir.Y());
-
-      if(dir.X() > 0 && dir.Y() < 0)
-      {
-         tpcBackAzimuth += 180;
-      }
-      else if(dir.X() < 0 && dir.Y() < 0)
-      {
-         tpcBackAzimuth -= 180;
-      }
-
-      double tpcBackAngleFromZ = dir.Unit().Dot(zdir);
-      tpcBackAngleFromZ = TMath::RadToDeg() * TMath::ACos(tpcBackAngleFromZ);
-
-      if(std::isnan(dir.X()) || !(
-         (tpcBackAngleFromZ >= Barrel::TpcAngleMin) &&
-         (fabs(tpcBackAzimuth) <= Barrel::TpcAzimuthAbs)))
-      {
-         i++;
-         continue;
-      }
-
-      if(track->Momentum > highestMomentum)
-      {
-         highestMomentum = track->Momentum;
-         tpcECalBox->barrelTrack = track;
-      }
-      i++;
-   }
+   Float_t unused = 0;
+   FindHighestMomentumInRegions(_acceptance, *segments,
+      tpcECalBox->negativeTracks, unused, nullptr, highestMomentum,
+      &tpcECalBox->barrelTrack);
+   FindHighestMomentumInRegions(_acceptance, *segments,
+      tpcECalBox->positiveTracks, unused, nullptr, highestMomentum,
+      &tpcECalBox->barrelTrack);
 
    return true;
 }
@@ -485,56 +714,61 @@ bool SelectTrackAction::Apply(AnaEventB& event, ToyBoxB& box) const
    return true;
 }
 
-bool FGDTPCTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
+bool FindECalTracksAction::Apply(AnaEventB& event, ToyBoxB& box) const
 {
    (void) event;
 
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
-
-   SubDetId::SubDetEnum det = tpcECalBox->DetectorFV;
-   EventBoxTracker::TrackGroupEnum groupID;
-   EventBoxB* eventBox = event.EventBoxes[AnaEventB::kEventBoxTracker];
-   AnaTrackB** fgd1Tracks = nullptr;
-   AnaTrackB** fgd2Tracks = nullptr;
-   int nFgd1Tracks = 0;
-   int nFgd2Tracks = 0;
-   switch(det)
+   const TPCBackSegmentCache* segments = tpcECalBox->segments;
+
+   Float_t dsMomentum = 0;
+   Float_t barrelMomentum = 0;
+   FindHighestMomentumInRegions(_acceptance, *segments,
+      tpcECalBox->negativeTracks, dsMomentum, &tpcECalBox->downstreamTrack,
+      barrelMomentum, &tpcECalBox->barrelTrack);
+   FindHighestMomentumInRegions(_acceptance, *segments,
+      tpcECalBox->positiveTracks, dsMomentum, &tpcECalBox->downstreamTrack,
+      barrelMomentum, &tpcECalBox->barrelTrack);
+
+   // As SelectTrackAction, the barrel takes priority
+   if(tpcECalBox->barrelTrack)
    {
-      case SubDetId::kFGD:
-         groupID = EventBoxTracker::kTracksWithGoodQualityTPCInFGD1FV;
-         fgd1Tracks = eventBox->TracksInGroup[groupID];
-         nFgd1Tracks = eventBox->nTracksInGroup[groupID];
-         groupID = EventBoxTracker::kTracksWithGoodQualityTPCInFGD2FV;
-         fgd2Tracks = eventBox->TracksInGroup[groupID];
-         nFgd2Tracks = eventBox->nTracksInGroup[groupID];
-         break;
-      case SubDetId::kFGD1:
-         groupID = EventBoxTracker::kTracksWithGoodQualityTPCInFGD1FV;
-         fgd1Tracks = eventBox->TracksInGroup[groupID];
-         nFgd1Tracks = eventBox->nTracksInGroup[groupID];
-         break;
-      case SubDetId::kFGD2:
-         groupID = EventBoxTracker::kTracksWithGoodQualityTPCInFGD2FV;
-         fgd2Tracks = eventBox->TracksInGroup[groupID];
-         nFgd2Tracks = eventBox->nTracksInGroup[groupID];
-         break;
-      default:
-         return false;
+      tpcECalBox->entersBarrel = true;
+      tpcECalBox->selectedTrack = tpcECalBox->barrelTrack;
    }
+   else if(tpcECalBox->downstreamTrack)
+   {
+      tpcECalBox->entersDownstream = true;
+      tpcECalBox->selectedTrack = tpcECalBox->downstreamTrack;
+   }
+
+   return true;
+}
+
+bool FGDTPCTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
+{
+   ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+
+   // The segment cache was built in InitializeEvent from the FGD1 and then the
+   // FGD2 good quality TPC tracks of the selection's fiducial volume.
+   EventBoxTPCECal* eventBox = &EventBoxTPCECal::Get(event);
+   TPCBackSegmentCache* segments = &eventBox->segments;
+   tpcECalBox->segments = segments;
+   segments->Refresh();
 
-   for(Int_t i = 0; i < nFgd1Tracks; ++i)
+   for(unsigned int i = 0; i < segments->GetNumFGD1Tracks(); ++i)
    {
-      AnaTrackB* track = fgd1Tracks[i];
-      tpcECalBox->fgd1Tracks.push_back(track);
+      tpcECalBox->fgd1Tracks.Add(segments->Track[i], i);
    }
 
-   for(Int_t i = 0; i < nFgd2Tracks; ++i)
+   for(unsigned int i = segments->GetNumFGD1Tracks();
+      i < segments->GetNumFGDTracks(); ++i)
    {
-      AnaTrackB* track = fgd2Tracks[i];
-      tpcECalBox->fgd2Tracks.push_back(track);
+      tpcECalBox->fgd2Tracks.Add(segments->Track[i], i);
    }
 
-   return (tpcECalBox->fgd1Tracks.size() + tpcECalBox->fgd2Tracks.size()) > 0;
+   return (tpcECalBox->fgd1Tracks.GetNumSelected() +
+      tpcECalBox->fgd2Tracks.GetNumSelected()) > 0;
 }
 
 bool FGDFVTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -543,69 +777,118 @@ bool FGDFVTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
    
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->fgd1Tracks.begin();
-   while(i != tpcECalBox->fgd1Tracks.end())
+   const char* inFGDFV = tpcECalBox->segments->InFGDFV.data();
+   TrackCandidateSet& fgd1Tracks = tpcECalBox->fgd1Tracks;
+   for(unsigned int i = 0; i < fgd1Tracks.GetNumEntries(); ++i)
    {
-      cutUtils::FiducialCut(*(*i), SubDetId::kFGD1) ?
-         i++ : tpcECalBox->fgd1Tracks.erase(i++);
+      if(fgd1Tracks.IsSelected(i) && !inFGDFV[fgd1Tracks.GetIndex(i)])
+      {
+         fgd1Tracks.Reject(i);
+      }
    } 
 
-   i = tpcECalBox->fgd2Tracks.begin();
-   while(i != tpcECalBox->fgd2Tracks.end())
+   TrackCandidateSet& fgd2Tracks = tpcECalBox->fgd2Tracks;
+   for(unsigned int i = 0; i < fgd2Tracks.GetNumEntries(); ++i)
    {
-      cutUtils::FiducialCut(*(*i), SubDetId::kFGD2) ?
-         i++ : tpcECalBox->fgd2Tracks.erase(i++);
+      if(fgd2Tracks.IsSelected(i) && !inFGDFV[fgd2Tracks.GetIndex(i)])
+      {
+         fgd2Tracks.Reject(i);
+      }
    }
 
-   return (tpcECalBox->fgd1Tracks.size() + tpcECalBox->fgd2Tracks.size()) > 0;
+   return (fgd1Tracks.GetNumSelected() + fgd2Tracks.GetNumSelected()) > 0;
 }
 
-bool SeparationTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
+/**
+   Adds every pair of selected candidates whose start positions are less than
+   10 cm apart to a pair set, in the order of a nested loop over the
+   candidates.
+
+   \param tracks  The candidates to pair.
+   \param pairs   The set to add the pairs to.
+*/
+static void PairCloseTracks(const TrackCandidateSet& tracks,
+   TrackPairCandidateSet& pairs)
 {
-   (void)event;
-   
-   ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+   const Float_t maxSeparation = SeparationTracksCut::MaxSeparation;
 
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->fgd1Tracks.begin();
-   while(i != tpcECalBox->fgd1Tracks.end())
+   // Sort the selected candidates by start z. A NaN z can never pass the
+   // separation cut, and would break the sort, so those are left out.
+   unsigned int* slots = scratchSlots.Get(tracks.GetNumEntries());
+   unsigned int n = 0;
+   for(unsigned int i = 0; i < tracks.GetNumEntries(); ++i)
    {
-      std::list<AnaTrackB*>::iterator j = ++(std::list<AnaTrackB*>::iterator(i));
-      while(j != tpcECalBox->fgd1Tracks.end())
+      if(tracks.IsSelected(i) && !std::isnan(tracks[i]->PositionStart[2]))
       {
-         float squaredSeparation =
-            cutUtils::GetSeparationSquared((*i)->PositionStart, (*j)->PositionStart);
-         if(squaredSeparation < 100)
-         {
-            tpcECalBox->fgdPairedTracks.push_back(
-               new std::pair<AnaTrackB*, AnaTrackB*>(*i, *j));
-         }
-         j++;
+         slots[n++] = i;
       }
-      i++;
    }
-
-   i = tpcECalBox->fgd2Tracks.begin();
-   while(i != tpcECalBox->fgd2Tracks.end())
+   std::sort(slots, slots + n,
+      [&tracks](unsigned int i, unsigned int j)
+      {
+         return tracks[i]->PositionStart[2] < tracks[j]->PositionStart[2];
+      });
+
+   // The z difference alone rounds to at least 10 cm once the sweep moves
+   // far enough, so the remaining candidates cannot pass. The pool is kept
+   // between events, so it only allocates when an event has more close pairs
+   // than any before it.
+   static std::vector<std::pair<unsigned int, unsigned int> > close;
+   close.clear();
+   for(unsigned int a = 0; a < n; ++a)
    {
-      std::list<AnaTrackB*>::iterator j = ++(std::list<AnaTrackB*>::iterator(i));
-      while(j != tpcECalBox->fgd2Tracks.end())
+      const Float_t* startA = tracks[slots[a]]->PositionStart;
+      for(unsigned int b = a + 1; b < n; ++b)
       {
-         float squaredSeparation =
-            cutUtils::GetSeparationSquared((*i)->PositionStart, (*j)->PositionStart);
-         if(squaredSeparation < 100)
+         const Float_t* startB = tracks[slots[b]]->PositionStart;
+         if(startB[2] - startA[2] >= maxSeparation)
+         {
+            break;
+         }
+         if(cutUtils::GetSeparationSquared(startA, startB) <
+            maxSeparation * maxSeparation)
          {
-            tpcECalBox->fgdPairedTracks.push_back(
-               new std::pair<AnaTrackB*, AnaTrackB*>(*i, *j));
+            close.push_back(std::make_pair(std::min(slots[a], slots[b]),
+               std::max(slots[a], slots[b])));
          }
-         j++;
       }
-      i++;
    }
 
-   tpcECalBox->fgd1Tracks.clear();
-   tpcECalBox->fgd2Tracks.clear();
+   // Restore the (i, j) order of the nested loop
+   std::sort(close.begin(), close.end());
+   for(unsigned int k = 0; k < close.size(); ++k)
+   {
+      const unsigned int i = close[k].first;
+      const unsigned int j = close[k].second;
+      TrackPair pair = {tracks[i], tracks[j], tracks.GetIndex(i),
+         tracks.GetIndex(j)};
+      pairs.Add(pair);
+   }
+}
+
+bool SeparationTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
+{
+   (void)event;
+   
+   ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
+
+   TrackCandidateSet& fgd1Tracks = tpcECalBox->fgd1Tracks;
+   TrackCandidateSet& fgd2Tracks = tpcECalBox->fgd2Tracks;
+   PairCloseTracks(fgd1Tracks, tpcECalBox->fgdPairedTracks);
+   PairCloseTracks(fgd2Tracks, tpcECalBox->fgdPairedTracks);
+
+   fgd1Tracks.Clear();
+   fgd2Tracks.Clear();
 
-   return tpcECalBox->fgdPairedTracks.size() > 0;
+   return tpcECalBox->fgdPairedTracks.GetNumSelected() > 0;
+}
+
+std::string SeparationTracksCut::GetConfiguration() const
+{
+   std::ostringstream config;
+   config << "MaxSeparation=" << MaxSeparation;
+
+   return config.str();
 }
 
 bool OppositeChargeTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -614,15 +897,18 @@ bool OppositeChargeTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
    
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
-   std::list<std::pair<AnaTrackB*, AnaTrackB*>*>::iterator i = tpcECalBox->fgdPairedTracks.begin();
-   while(i != tpcECalBox->fgdPairedTracks.end())
+   const Float_t* charge = tpcECalBox->segments->TrackCharge.data();
+   TrackPairCandidateSet& pairs = tpcECalBox->fgdPairedTracks;
+   for(unsigned int i = 0; i < pairs.GetNumEntries(); ++i)
    {
-      std::pair<AnaTrackB*, AnaTrackB*>* pair = *i;
-      (pair->first->Charge == pair->second->Charge) ?
-         tpcECalBox->fgdPairedTracks.erase(i++) : i++;
+      if(pairs.IsSelected(i) &&
+         charge[pairs[i].firstRow] == charge[pairs[i].secondRow])
+      {
+         pairs.Reject(i);
+      }
    }
 
-   return tpcECalBox->fgdPairedTracks.size() > 0;
+   return pairs.GetNumSelected() > 0;
 }
 
 bool NegativePartnerTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -631,22 +917,26 @@ bool NegativePartnerTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
 
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
    
-   std::list<std::pair<AnaTrackB*, AnaTrackB*>*>::iterator i = tpcECalBox->fgdPairedTracks.begin();
-   while(i != tpcECalBox->fgdPairedTracks.end())
+   const Float_t* charge = tpcECalBox->segments->TrackCharge.data();
+   TrackPairCandidateSet& pairs = tpcECalBox->fgdPairedTracks;
+   for(unsigned int i = 0; i < pairs.GetNumEntries(); ++i)
    {
-      std::pair<AnaTrackB*, AnaTrackB*>* pair = *i;
-      if(pair->first->Charge < 0)
+      if(!pairs.IsSelected(i))
+      {
+         continue;
+      }
+      const TrackPair& pair = pairs[i];
+      if(charge[pair.firstRow] < 0)
       {
-         tpcECalBox->negativeTracks.push_back(pair->first);
+         tpcECalBox->negativeTracks.Add(pair.first, pair.firstRow);
       }
-      else if(pair->second->Charge < 0)
+      else if(charge[pair.secondRow] < 0)
       {
-         tpcECalBox->negativeTracks.push_back(pair->second);
+         tpcECalBox->negativeTracks.Add(pair.second, pair.secondRow);
       }
-      i++;
    }
 
-   return tpcECalBox->negativeTracks.size() > 0;
+   return tpcECalBox->negativeTracks.GetNumSelected() > 0;
 }
 
 bool PositivePartnerTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -655,22 +945,26 @@ bool PositivePartnerTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
 
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
    
-   std::list<std::pair<AnaTrackB*, AnaTrackB*>*>::iterator i = tpcECalBox->fgdPairedTracks.begin();
-   while(i != tpcECalBox->fgdPairedTracks.end())
+   const Float_t* charge = tpcECalBox->segments->TrackCharge.data();
+   TrackPairCandidateSet& pairs = tpcECalBox->fgdPairedTracks;
+   for(unsigned int i = 0; i < pairs.GetNumEntries(); ++i)
    {
-      std::pair<AnaTrackB*, AnaTrackB*>* pair = *i;
-      if(pair->first->Charge > 0)
+      if(!pairs.IsSelected(i))
       {
-         tpcECalBox->positiveTracks.push_back(pair->first);
+         continue;
+      }
+      const TrackPair& pair = pairs[i];
+      if(charge[pair.firstRow] > 0)
+      {
+         tpcECalBox->positiveTracks.Add(pair.first, pair.firstRow);
       }
-      else if(pair->second->Charge > 0)
+      else if(charge[pair.secondRow] > 0)
       {
-         tpcECalBox->positiveTracks.push_back(pair->second);
+         tpcECalBox->positiveTracks.Add(pair.second, pair.secondRow);
       }
-      i++;
    }
 
-   return tpcECalBox->positiveTracks.size() > 0;
+   return tpcECalBox->positiveTracks.GetNumSelected() > 0;
 }
 
 bool PositiveTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -679,30 +973,29 @@ bool PositiveTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
    
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->fgd1Tracks.begin();
-   while(i != tpcECalBox->fgd1Tracks.end())
+   const Float_t* charge = tpcECalBox->segments->TrackCharge.data();
+   TrackCandidateSet& fgd1Tracks = tpcECalBox->fgd1Tracks;
+   for(unsigned int i = 0; i < fgd1Tracks.GetNumEntries(); ++i)
    {
-      if((*i)->Charge > 0)
+      if(fgd1Tracks.IsSelected(i) && charge[fgd1Tracks.GetIndex(i)] > 0)
       {
-         tpcECalBox->positiveTracks.push_back(*i);
+         tpcECalBox->positiveTracks.Add(fgd1Tracks[i], fgd1Tracks.GetIndex(i));
       }
-      i++;
    }
 
-   i = tpcECalBox->fgd2Tracks.begin();
-   while(i != tpcECalBox->fgd2Tracks.end())
+   TrackCandidateSet& fgd2Tracks = tpcECalBox->fgd2Tracks;
+   for(unsigned int i = 0; i < fgd2Tracks.GetNumEntries(); ++i)
    {
-      if((*i)->Charge > 0)
+      if(fgd2Tracks.IsSelected(i) && charge[fgd2Tracks.GetIndex(i)] > 0)
       {
-         tpcECalBox->positiveTracks.push_back(*i);
+         tpcECalBox->positiveTracks.Add(fgd2Tracks[i], fgd2Tracks.GetIndex(i));
       }
-      i++;
    }
 
-   tpcECalBox->fgd1Tracks.clear();
-   tpcECalBox->fgd2Tracks.clear();
+   fgd1Tracks.Clear();
+   fgd2Tracks.Clear();
 
-   return tpcECalBox->positiveTracks.size() > 0;
+   return tpcECalBox->positiveTracks.GetNumSelected() > 0;
 }
 
 bool NegativeTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -711,30 +1004,29 @@ bool NegativeTracksCut::Apply(AnaEventB& event, ToyBoxB& box) const
    
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->fgd1Tracks.begin();
-   while(i != tpcECalBox->fgd1Tracks.end())
+   const Float_t* charge = tpcECalBox->segments->TrackCharge.data();
+   TrackCandidateSet& fgd1Tracks = tpcECalBox->fgd1Tracks;
+   for(unsigned int i = 0; i < fgd1Tracks.GetNumEntries(); ++i)
    {
-      if((*i)->Charge < 0)
+      if(fgd1Tracks.IsSelected(i) && charge[fgd1Tracks.GetIndex(i)] < 0)
       {
-         tpcECalBox->negativeTracks.push_back(*i);
+         tpcECalBox->negativeTracks.Add(fgd1Tracks[i], fgd1Tracks.GetIndex(i));
       }
-      i++;
    }
 
-   i = tpcECalBox->fgd2Tracks.begin();
-   while(i != tpcECalBox->fgd2Tracks.end())
+   TrackCandidateSet& fgd2Tracks = tpcECalBox->fgd2Tracks;
+   for(unsigned int i = 0; i < fgd2Tracks.GetNumEntries(); ++i)
    {
-      if((*i)->Charge > 0)
+      if(fgd2Tracks.IsSelected(i) && charge[fgd2Tracks.GetIndex(i)] > 0)
       {
-         tpcECalBox->negativeTracks.push_back(*i);
+         tpcECalBox->negativeTracks.Add(fgd2Tracks[i], fgd2Tracks.GetIndex(i));
       }
-      i++;
    }
 
-   tpcECalBox->fgd1Tracks.clear();
-   tpcECalBox->fgd2Tracks.clear();
+   fgd1Tracks.Clear();
+   fgd2Tracks.Clear();
 
-   return tpcECalBox->negativeTracks.size() > 0;
+   return tpcECalBox->negativeTracks.GetNumSelected() > 0;
 }
 
 bool HighestMomentumTrackCut::Apply(AnaEventB& event, ToyBoxB& box) const
@@ -743,45 +1035,41 @@ bool HighestMomentumTrackCut::Apply(AnaEventB& event, ToyBoxB& box) const
    
    ToyBoxTPCECal *tpcECalBox = static_cast<ToyBoxTPCECal*>(&box);
 
-   Float_t highestMomentum = 0;
-   AnaTrackB* hmTrack = nullptr;
-   std::list<AnaTrackB*>::iterator i = tpcECalBox->positiveTracks.begin();
-   while(i != tpcECalBox->positiveTracks.end())
+   // The highest momentum positive track is preferred
+   const Float_t* momentum = tpcECalBox->segments->TrackMomentum.data();
+   TrackCandidateSet* sets[2] = {&tpcECalBox->positiveTracks,
+      &tpcECalBox->negativeTracks};
+   for(int s = 0; s < 2; ++s)
    {
-      if((*i)->Momentum > highestMomentum)
+      TrackCandidateSet& tracks = *sets[s];
+      int* rows = nullptr;
+      unsigned int* slots = nullptr;
+      const unsigned int n = GatherSelectedRows(tracks, rows, slots);
+
+      const int highest = FindHighest(momentum, rows, n);
+      if(highest >= 0)
       {
-         highestMomentum = (*i)->Momentum;
-         hmTrack = *i;
+         tracks.KeepOnly(slots[highest]);
+
+         return tracks.GetNumSelected() > 0;
       }
-      i++;
    }
-   if(hmTrack)
-   {
-      tpcECalBox->positiveTracks.clear();
-      tpcECalBox->positiveTracks.push_back(hmTrack);
 
-      return tpcECalBox->positiveTracks.size() > 0;
-   }
+   return false;
+}
 
-   highestMomentum = 0;
-   hmTrack = nullptr;
-   i = tpcECalBox->negativeTracks.begin();
-   while(i != tpcECalBox->negativeTracks.end())
-   {
-      if((*i)->Momentum > highestMomentum)
-      {
-         highestMomentum = (*i)->Momentum;
-         hmTrack = *i;
-      }
-      i++;
-   }
-   if(hmTrack)
+int HighestMomentumTrackCut::FindHighest(const Float_t* momentum,
+   const int* rows, const unsigned int n)
+{
+   Float_t highestMomentum = 0;
+   int highest = -1;
+   for(unsigned int i = 0; i < n; ++i)
    {
-      tpcECalBox->negativeTracks.clear();
-      tpcECalBox->negativeTracks.push_back(hmTrack);
-
-      return tpcECalBox->negativeTracks.size() > 0;
+      const Float_t p = momentum[rows[i]];
+      const bool higher = p > highestMomentum;
+      highestMomentum = higher ? p : highestMomentum;
+      highest = higher ? static_cast<int>(i) : highest;
    }
 
-   return false;
+   return highest;
 }
@@ -1,9 +1,29 @@
 #ifndef TPCECalSelection_h
 #define TPCECalSelection_h
 
-#include <list>
 #include "SelectionBase.hxx"
 #include "Parameters.hxx"
+#include "CandidateSet.hxx"
+#include "TPCBackSegmentCache.hxx"
+#include "StepProfiler.hxx"
+#include "StepMemo.hxx"
+#include "StepCheckpoint.hxx"
+
+/// Number of track pairs ToyBoxTPCECal has space for before its pair set grows
+const unsigned int NMAXTPCECALPAIRS = 1024;
+
+/// Two candidate tracks with nearby start positions, and their segment cache
+/// rows
+struct TrackPair
+{
+   AnaTrackB* first;
+   AnaTrackB* second;
+   int firstRow;
+   int secondRow;
+};
+
+typedef CandidateSet<AnaTrackB*, NMAXTPCECALCANDIDATES> TrackCandidateSet;
+typedef CandidateSet<TrackPair, NMAXTPCECALPAIRS> TrackPairCandidateSet;
 
 //---- Define an specific box for this selection -------
 class ToyBoxTPCECal: public ToyBoxB
@@ -11,25 +31,15 @@ class ToyBoxTPCECal: public ToyBoxB
 public:
    ToyBoxTPCECal()
    {
-      isElectronLike = false;
-      isMuonLike = false;
-      isAntiMuonLike = false;
-      isProtonLike = false;
-      entersBarrel = false;
-      entersDownstream = false;
-      downstreamTrack = nullptr;
-      barrelTrack = nullptr;
-      selectedTrack = nullptr;
-      negativeTracks.clear();
-      positiveTracks.clear();
-      fgd1Tracks.clear();
-      fgd2Tracks.clear();
-      fgdPairedTracks.clear();
+      Reset();
    }
 
+   /// Resets the box for the next toy. The candidate sets keep their storage,
+   /// so this is O(1) and never frees memory.
    virtual void Reset()
    {
       isElectronLike = false;
+      isPositronLike = false;
       isMuonLike = false;
       isAntiMuonLike = false;
       isProtonLike = false;
@@ -38,15 +48,52 @@ public:
       downstreamTrack = nullptr;
       barrelTrack = nullptr;
       selectedTrack = nullptr;
-      negativeTracks.clear();
-      positiveTracks.clear();
-      fgd1Tracks.clear();
-      fgd2Tracks.clear();
-      fgdPairedTracks.clear();
+      segments = nullptr;
+      negativeTracks.Clear();
+      positiveTracks.Clear();
+      fgd1Tracks.Clear();
+      fgd2Tracks.Clear();
+      fgdPairedTracks.Clear();
    }
   
    virtual ~ToyBoxTPCECal(){ }
 
+   /// Makes this box a copy of another. Unlike the copy constructor, this only
+   /// copies the candidate set slots in use.
+   void CopyState(const ToyBoxTPCECal& other)
+   {
+      isElectronLike = other.isElectronLike;
+      isPositronLike = other.isPositronLike;
+      isMuonLike = other.isMuonLike;
+      isAntiMuonLike = other.isAntiMuonLike;
+      isProtonLike = other.isProtonLike;
+      entersBarrel = other.entersBarrel;
+      entersDownstream = other.entersDownstream;
+      downstreamTrack = other.downstreamTrack;
+      barrelTrack = other.barrelTrack;
+      selectedTrack = other.selectedTrack;
+      segments = other.segments;
+      negativeTracks.CopyFrom(other.negativeTracks);
+      positiveTracks.CopyFrom(other.positiveTracks);
+      fgd1Tracks.CopyFrom(other.fgd1Tracks);
+      fgd2Tracks.CopyFrom(other.fgd2Tracks);
+      fgdPairedTracks.CopyFrom(other.fgdPairedTracks);
+   }
+
+   /// Adds a track to a candidate set, tagging it with its segment cache row
+   void AddCandidate(TrackCandidateSet& tracks, AnaTrackB* track)
+   {
+      tracks.Add(track, segments->FindOrAdd(track));
+   }
+
+   /// Counts the candidates still selected in all of the candidate sets
+   unsigned int GetNumCandidates() const
+   {
+      return negativeTracks.GetNumSelected() + positiveTracks.GetNumSelected()
+         + fgd1Tracks.GetNumSelected() + fgd2Tracks.GetNumSelected() +
+         fgdPairedTracks.GetNumSelected();
+   }
+
    /// Describes whether this track is thought to be an electron
    bool isElectronLike;
    /// Describes whether this track is thought to be a positron
@@ -63,16 +110,17 @@ public:
    bool entersDownstream;
 
    /// All negative tracks
-   std::list<AnaTrackB*> negativeTracks;
+   TrackCandidateSet negativeTracks;
    /// All positive tracks
-   std::list<AnaTrackB*> positiveTracks;
+   TrackCandidateSet positiveTracks;
 
    /// FGD1 tracks
-   std::list<AnaTrackB*> fgd1Tracks;
+   TrackCandidateSet fgd1Tracks;
    /// FGD2 tracks
-   std::list<AnaTrackB*> fgd2Tracks;
-   /// Pairs of tracks
-   std::list<std::pair<AnaTrackB*, AnaTrackB*>*> fgdPairedTracks;
+   TrackCandidateSet fgd2Tracks;
+   /// Pairs of tracks. The pairs are stored by value, so this is also the
+   /// pair pool and is recycled by Reset.
+   TrackPairCandidateSet fgdPairedTracks;
 
    /// Track appearing to enter the downstream ECal.
    AnaTrackB* downstreamTrack;
@@ -80,36 +128,289 @@ public:
    AnaTrackB* barrelTrack;
    /// The selected track.
    AnaTrackB* selectedTrack;
+
+   /// Back TPC segment cache of the current event, owned by its EventBox and
+   /// set by FGDTPCTracksCut. Candidate set indices are rows of this cache.
+   TPCBackSegmentCache* segments;
 };
 
+/// Systematically varied quantities that the result of a step can depend on
+enum StepDependencyEnum
+{
+   kNoDependencies = 0,
+   kDependsOnMomentum = 1 << 0,
+   kDependsOnCharge = 1 << 1,
+   kDependsOnPID = 1 << 2,
+   kDependsOnAll = kDependsOnMomentum | kDependsOnCharge | kDependsOnPID
+};
+
+/**
+   A step that declares which systematically varied quantities it reads. A step
+   that reads none gives the same result for every toy of an event, given the
+   same candidates.
+*/
+class TPCECalStepBase: public StepBase
+{
+public:
+   /**
+      Retrieves the varied quantities the step reads.
+
+      \return  The StepDependencyEnum flags of the quantities.
+   */
+   virtual unsigned int GetDependencies() const { return kDependsOnAll; }
+
+   /**
+      Describes the tunable values of the step, e.g. its thresholds, so that a
+      StepCheckpoint can tell when they change.
+
+      \return  The values as text, or an empty string if the step has none.
+   */
+   virtual std::string GetConfiguration() const { return ""; }
+};
+
+/**
+   Base class of the TPC/ECal selections. Steps added through it are wrapped
+   by the StepProfiler when step profiling is enabled.
+
+   The steps at the start of the trunk that depend on no varied quantity are
+   memoised by a StepMemo, if Selections.MemoiseInvariantSteps is set, so they
+   are only applied for the first toy of each event, and only by the first
+   selection whose trunk starts with them.
+
+   When the StepCheckpointer has a checkpoint to save or resume from, every
+   trunk step also goes through the StepCheckpoint of the selection.
+*/
+class TPCECalSelectionBase: public SelectionBase
+{
+public:
+   /**
+      \param forceBreak  Passed to SelectionBase.
+      \param name  The name of the selection in the step profile.
+   */
+   TPCECalSelectionBase(bool forceBreak, const std::string& name);
+   virtual ~TPCECalSelectionBase(){ }
+
+   /// Creates the EventBoxTPCECal of the event, and fills it if no other
+   /// TPC/ECal selection has yet
+   void InitializeEvent(AnaEventB& event);
+
+   /// Adds a step to the trunk, as SelectionBase::AddStep
+   void AddStep(StepBase::TypeEnum type, const std::string& title,
+      StepBase* step, bool cut_break = false);
+
+   /// Adds a step to a branch, as SelectionBase::AddStep
+   void AddStep(Int_t branch, StepBase::TypeEnum type,
+      const std::string& title, StepBase* step, bool cut_break = false);
+
+   /**
+      Retrieves the number of steps at the start of the trunk that are
+      memoised.
+
+      \return  The number of steps.
+   */
+   unsigned int GetNumMemoisedSteps() const { return _memo.GetNumSteps(); }
+
+private:
+   std::string _profileName;
+   /// Whether every step added to the trunk so far has been memoised
+   bool _memoising;
+   StepMemo _memo;
+   /// The checkpoint of the selection, owned by the StepCheckpointer, or null
+   /// if checkpoints are not in use
+   StepCheckpoint* _checkpoint;
+   /// Key of the configuration of the trunk steps added so far
+   ULong64_t _stepKey;
+   /// Number of trunk steps added so far
+   unsigned int _nTrunkSteps;
+};
+
+/**
+   Geometry policies of the ECal acceptance and TPC quality cuts. The limits
+   are compile-time constants, so the acceptance kernel instantiated with them
+   is specialised to the geometry.
+*/
 class Barrel
 {
 public:
-   static const float TpcXMin = -890;
-   static const float TpcXMax = +890;
-   static const float TpcYMin = -980;
-   static const float TpcYMax = +1085;
-   static const float TpcZMin = +600;
-   static const float TpcZMax = +2600;
-   static const float TpcAzimuthAbs = +160;
-   static const float TpcAngleMin = +35;
+   static constexpr float TpcXMin = -890;
+   static constexpr float TpcXMax = +890;
+   static constexpr float TpcYMin = -980;
+   static constexpr float TpcYMax = +1085;
+   static constexpr float TpcZMin = +600;
+   static constexpr float TpcZMax = +2600;
+   static constexpr float TpcAzimuthAbs = +160;
+   static constexpr float TpcAngleMin = +35;
 };
 
 class DS
 {
 public:
-   static const float TpcXMin = -920;
-   static const float TpcXMax = +920;
-   static const float TpcYMin = -910;
-   static const float TpcYMax = +930;
-   static const float TpcZMin = +2665;
-   static const float TpcAngleMax = +40;
+   static constexpr float TpcXMin = -920;
+   static constexpr float TpcXMax = +920;
+   static constexpr float TpcYMin = -910;
+   static constexpr float TpcYMax = +930;
+   static constexpr float TpcZMin = +2665;
+   static constexpr float TpcAngleMax = +40;
 };
 
 class TPC
 {
 public:
-   static const int MinimumNodes = 19;
+   static constexpr int MinimumNodes = 19;
+};
+
+/**
+   Classifies candidate tracks by the ECal region their back TPC segment
+   points into.
+
+   The angular limits of the DS and barrel geometries are converted into
+   squared cosine thresholds once, on construction, so that classification only
+   needs products and comparisons of the segment cache columns. The tests
+   reproduce the TVector3 based definitions, including their treatment of zero
+   and undefined directions.
+
+   The kernel is instantiated for the DS and Barrel geometry policies in
+   TPCECalSelection.cxx; use ECalAcceptanceKernel.
+*/
+template <class DSGeometry, class BarrelGeometry>
+class ECalAcceptanceKernelT
+{
+public:
+   /// Region flags set by Classify
+   enum RegionEnum
+   {
+      kNoECal = 0,
+      kDownstream = 1 << 0,
+      kBarrel = 1 << 1
+   };
+
+   /// Uses the angular limits of the geometries
+   ECalAcceptanceKernelT();
+
+   /**
+      Uses other angular limits, e.g. to scan them. The DS and polar limits
+      must be at most 90 degrees and the azimuthal limit at least 90 degrees.
+
+      \param dsAngleMax The largest angle from z of the DS, in degrees.
+      \param barrelAngleMin The smallest angle from z of the barrel, in
+                           degrees.
+      \param barrelAzimuthAbs  The largest absolute azimuth from y of the
+                              barrel, in degrees.
+   */
+   ECalAcceptanceKernelT(const double dsAngleMax, const double barrelAngleMin,
+      const double barrelAzimuthAbs);
+   virtual ~ECalAcceptanceKernelT(){ }
+
+   /**
+      Classifies a batch of segment cache rows.
+
+      \param segments   The segment cache holding the rows.
+      \param rows    The rows to classify.
+      \param n       The number of rows.
+      \param regions The RegionEnum flags of each row.
+   */
+   void Classify(const TPCBackSegmentCache& segments, const int* rows,
+      const unsigned int n, unsigned char* regions) const;
+
+   /**
+      Describes the limits of the geometries the kernel was instantiated with.
+
+      \return  The limits as text.
+   */
+   static std::string GetConfiguration();
+
+private:
+   double _cos2DSAngleMax;
+   double _cos2BarrelAngleMin;
+   double _cos2BarrelAzimuthAbs;
+};
+
+/// The acceptance kernel of the ND280 ECal geometry
+typedef ECalAcceptanceKernelT<DS, Barrel> ECalAcceptanceKernel;
+
+/**
+   The TPC pull windows that a candidate of one particle species must satisfy.
+
+   Each of the muon, electron, pion and proton pulls of the back TPC segment is
+   either ignored, required to lie inside a window or required to lie outside
+   it. The windows are read from the parameters file, e.g. for the electron
+   pull of the electron selection:
+
+      TPCECalSystematicsAnalysis.PID.Electron.Pullele.Mode
+      TPCECalSystematicsAnalysis.PID.Electron.Pullele.Min
+      TPCECalSystematicsAnalysis.PID.Electron.Pullele.Max
+
+   The limits of an ignored pull need not be given.
+*/
+class PIDWindowTable
+{
+public:
+   /// How a pull is tested against its window
+   enum ModeEnum
+   {
+      kIgnore = 0,   ///< Any value passes
+      kInside = 1,   ///< Min < pull < Max passes
+      kOutside = 2   ///< pull < Min or pull > Max passes
+   };
+
+   /// The pulls, in the order of their windows
+   enum PullEnum
+   {
+      kPullmu = 0,
+      kPullele,
+      kPullpi,
+      kPullp,
+      kNPulls
+   };
+
+   /**
+      Reads the windows of a species from the parameters file.
+
+      \param species The name of the species in the parameter names, e.g.
+                     "Electron".
+   */
+   PIDWindowTable(const std::string& species);
+   virtual ~PIDWindowTable(){ }
+
+   /**
+      Tests a batch of segment cache rows against the windows. A row passes if
+      its back TPC segment has a positive momentum and every pull satisfies its
+      window, so rows without a segment fail.
+
+      \param segments   The segment cache holding the rows.
+      \param rows    The rows to test.
+      \param n       The number of rows.
+      \param pass    Set to whether each row passes.
+   */
+   void Evaluate(const TPCBackSegmentCache& segments, const int* rows,
+      const unsigned int n, bool* pass) const;
+
+   /**
+      Rejects the selected candidates of a set that fail the windows.
+
+      \param segments   The segment cache of the current event.
+      \param tracks  The candidates to test.
+      \return  The number of candidates still selected.
+   */
+   unsigned int Select(const TPCBackSegmentCache& segments,
+      TrackCandidateSet& tracks) const;
+
+   /**
+      Describes the windows, for TPCECalStepBase::GetConfiguration.
+
+      \return  The mode and limits of each pull as text.
+   */
+   std::string GetConfiguration() const;
+
+private:
+   /// Tests rows given the momentum and pull columns of one toy
+   void EvaluateColumns(const Float_t* momentum,
+      const Float_t* const* pulls, const int* rows, const unsigned int n,
+      bool* pass) const;
+
+   unsigned char _mode[kNPulls];
+   double _min[kNPulls];
+   double _max[kNPulls];
 };
 
 ///---- Define all steps -------
@@ -173,43 +474,65 @@ class TrackQualityFiducialCut: public StepBase{
   StepBase* MakeClone(){return new TrackQualityFiducialCut();}
 };
 
-class TPCTrackQualityCut: public StepBase{
+class TPCTrackQualityCut: public TPCECalStepBase{
  public:
   using StepBase::Apply;
   bool Apply(AnaEventB& event, ToyBoxB& box) const;
   StepBase* MakeClone(){return new TPCTrackQualityCut();}
+  std::string GetConfiguration() const;
+
+  /**
+     Tests segment cache rows for the minimum number of TPC nodes.
+
+     \param segments   The segment cache holding the rows.
+     \param rows    The rows to test.
+     \param n       The number of rows.
+     \param pass    Set to whether each row passes.
+  */
+  static void Evaluate(const TPCBackSegmentCache& segments, const int* rows,
+     const unsigned int n, bool* pass);
 };
 
-class TotalMultiplicityCut: public StepBase{
+class TotalMultiplicityCut: public TPCECalStepBase{
  public:
   using StepBase::Apply;
   bool Apply(AnaEventB& event, ToyBoxB& box) const;
   StepBase* MakeClone(){return new TotalMultiplicityCut();}
+  unsigned int GetDependencies() const {return kNoDependencies;}
 };
 
-class MultiplicityCut: public StepBase{
+class MultiplicityCut: public TPCECalStepBase{
 public:
    MultiplicityCut(const unsigned int minTracks) : minimumTracks(minTracks) { }
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
    StepBase* MakeClone(){return new MultiplicityCut(minimumTracks);}
+   unsigned int GetDependencies() const {return kNoDependencies;}
+   std::string GetConfiguration() const;
 
 private:
    unsigned int minimumTracks;
 };
 
-class ExternalVetoCut: public StepBase{
+/// Rejects candidates with a veto track. The veto compares the momentum of
+/// the veto track with that of the candidate, so is not toy invariant.
+class ExternalVetoCut: public TPCECalStepBase{
  public:
   using StepBase::Apply;
   bool Apply(AnaEventB& event, ToyBoxB& box) const;
   StepBase* MakeClone(){return new ExternalVetoCut();}
+  unsigned int GetDependencies() const {return kDependsOnMomentum;}
 };
 
-class ExternalFGD1lastlayersCut: public StepBase{
+class ExternalFGD1lastlayersCut: public TPCECalStepBase{
  public:
+  /// Candidates must start upstream of this z
+  static constexpr float MaxStartZ = 425;
+
   using StepBase::Apply;
   bool Apply(AnaEventB& event, ToyBoxB& box) const;
   StepBase* MakeClone(){return new ExternalFGD1lastlayersCut();}
+  std::string GetConfiguration() const;
 };
 
 /// Find the Vertex. For the moment it's just the Star position of the HM track
@@ -234,12 +557,19 @@ class FindOOFVTrackAction: public StepBase{
   StepBase* MakeClone(){return new FindOOFVTrackAction();}
 };
 
-class FindDownstreamTracksAction: public StepBase
+class FindDownstreamTracksAction: public TPCECalStepBase
 {
    public:
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
    StepBase* MakeClone(){ return new FindDownstreamTracksAction(); }
+   std::string GetConfiguration() const
+   {
+      return ECalAcceptanceKernel::GetConfiguration();
+   }
+
+   private:
+   ECalAcceptanceKernel _acceptance;
 };
 
 class DownstreamTracksCut: public StepBase
@@ -250,12 +580,19 @@ class DownstreamTracksCut: public StepBase
    StepBase* MakeClone(){ return new DownstreamTracksCut(); }
 };
 
-class FindBarrelTracksAction: public StepBase
+class FindBarrelTracksAction: public TPCECalStepBase
 {
    public:
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
    StepBase* MakeClone(){ return new FindBarrelTracksAction(); }
+   std::string GetConfiguration() const
+   {
+      return ECalAcceptanceKernel::GetConfiguration();
+   }
+
+   private:
+   ECalAcceptanceKernel _acceptance;
 };
 
 class BarrelTracksCut: public StepBase
@@ -274,28 +611,60 @@ class SelectTrackAction: public StepBase
    StepBase* MakeClone(){ return new SelectTrackAction(); }
 };
 
-class FGDTPCTracksCut: public StepBase
+/// Does the work of FindDownstreamTracksAction, FindBarrelTracksAction and
+/// SelectTrackAction in a single pass over the candidates
+class FindECalTracksAction: public TPCECalStepBase
+{
+   public:
+   using StepBase::Apply;
+   bool Apply(AnaEventB& event, ToyBoxB& box) const;
+   StepBase* MakeClone(){ return new FindECalTracksAction(); }
+   std::string GetConfiguration() const
+   {
+      return ECalAcceptanceKernel::GetConfiguration();
+   }
+
+   private:
+   ECalAcceptanceKernel _acceptance;
+};
+
+/// Loads the FGD tracks with a good quality TPC segment as candidates. This is
+/// the first TPC/ECal step of every selection, so it also attaches the event's
+/// segment cache to the box and refreshes its toy-varied columns.
+class FGDTPCTracksCut: public TPCECalStepBase
 {
 public:
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
    StepBase* MakeClone(){return new FGDTPCTracksCut();}
+   unsigned int GetDependencies() const {return kNoDependencies;}
 };
 
-class FGDFVTracksCut: public StepBase
+/// Keeps the candidates that start in the FGD fiducial volume, as found when
+/// the segment cache was built
+class FGDFVTracksCut: public TPCECalStepBase
 {
 public:
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
    StepBase* MakeClone(){return new FGDFVTracksCut();}
+   unsigned int GetDependencies() const {return kNoDependencies;}
 };
 
-class SeparationTracksCut: public StepBase
+/// Pairs FGD1 tracks, and FGD2 tracks, that start within 10 cm of each other.
+/// The tracks are swept in z, so only pairs less than 10 cm apart in z are
+/// compared.
+class SeparationTracksCut: public TPCECalStepBase
 {
 public:
+   /// Maximum separation of the start positions of a pair
+   static constexpr float MaxSeparation = 10;
+
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
    StepBase* MakeClone(){return new SeparationTracksCut();}
+   unsigned int GetDependencies() const {return kNoDependencies;}
+   std::string GetConfiguration() const;
 };
 
 class OppositeChargeTracksCut: public StepBase
@@ -335,7 +704,7 @@ class NegativeTracksCut: public StepBase
 public:
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
-   StepBase* MakeClone(){return new PositiveTracksCut();}
+   StepBase* MakeClone(){return new NegativeTracksCut();}
 };
 
 class HighestMomentumTrackCut: public StepBase
@@ -344,6 +713,19 @@ public:
    using StepBase::Apply;
    bool Apply(AnaEventB& event, ToyBoxB& box) const;
    StepBase* MakeClone(){return new HighestMomentumTrackCut();}
+
+   /**
+      Finds the row with the highest positive global track momentum. Ties go
+      to the earliest row.
+
+      \param momentum   The global track momentum column of one toy.
+      \param rows    The rows to search.
+      \param n       The number of rows.
+      \return  The position in rows of the highest momentum row, or -1 if no
+               row has a positive momentum.
+   */
+   static int FindHighest(const Float_t* momentum, const int* rows,
+      const unsigned int n);
 };
 
 #endif
@@ -10,18 +10,44 @@
 #include "BasicUtils.hxx"
 #include "baseToyMaker.hxx"
 #include "SubDetId.hxx"
+#include "StepProfiler.hxx"
+#include "ThresholdScan.hxx"
+#include "EventBoxTPCECal.hxx"
 
-TPCECalSystematicsAnalysis::TPCECalSystematicsAnalysis(AnalysisAlgorithm* ana) : baseAnalysis(ana) {
+/// Category prefixes of the selections when they are all run together. These
+/// match the particle names used by RunTPCECalPlot.
+const char* const SELECTIONPREFIXES[NTPCECALSELECTIONS] =
+{
+   "e_", "mu_", "p_", "ebar_", "mubar_"
+};
+
+bool TPCECalSystematicsAnalysis::_skimmedInput = false;
+
+TPCECalSystematicsAnalysis::TPCECalSystematicsAnalysis(AnalysisAlgorithm* ana) : baseAnalysis(ana), _runAllSelections(false) {
   // Add the package version (to be stored in the "config" tree)
   ND::versioning().AddPackage("TPCECalSystematicsAnalysis", anaUtils::GetSoftwareVersionFromPath((std::string)getenv("TPCECALSYSTEMATICSANALYSISROOT")));
 }
 
 bool TPCECalSystematicsAnalysis::Initialize(){
+  // Needed before the selections and micro-trees are defined
+  _runAllSelections = ND::params().GetParameterI(
+    "TPCECalSystematicsAnalysis.Selections.RunAllSelections");
+  StepProfiler::Get().SetEnabled(ND::params().GetParameterI(
+    "TPCECalSystematicsAnalysis.Profiling.ProfileSteps"));
+  if(!ThresholdScan::Get().Configure()) return false;
+
   // Initialize the base class
   if (!baseAnalysis::Initialize()) return false;
 
   // Define categories
   ND::categ().AddStandardCategories();
+  if(_runAllSelections)
+  {
+    for(unsigned int isel = 0; isel < NTPCECALSELECTIONS; ++isel)
+    {
+      ND::categ().AddStandardCategories(SELECTIONPREFIXES[isel]);
+    }
+  }
 
   // Minimum accum level to save event into the output Micro-trees
   SetMinAccumCutLevelToSave(ND::params().GetParameterI("TPCECalSystematicsAnalysis.MinAccumLevelToSave"));
@@ -37,6 +63,12 @@ void TPCECalSystematicsAnalysis::DefineSelections(){
    sel().AddSelection("TPCECalPositron",  "TPC/ECal positron selection", new TPCECalPositronSelection(false));
    sel().AddSelection("TPCECalAntiMuon",  "TPC/ECal antimuon selection", new TPCECalAntiMuonSelection(false));
 
+   if(_runAllSelections)
+   {
+      std::cout << "Running all selections" << std::endl;
+      return;
+   }
+
    if(!ND::params().GetParameterI(
       "TPCECalSystematicsAnalysis.Selections.RunMuonSelection"))
    {
@@ -82,6 +114,22 @@ void TPCECalSystematicsAnalysis::DefineSystematics(){
 void TPCECalSystematicsAnalysis::DefineConfigurations(){
   // Some configurations are defined in baseTrackerAnalysis (have a look at baseTrackerAnalysis/vXrY/src/baseTrackerAnalysis.cxx)
   baseAnalysis::DefineConfigurations();
+
+  // The standard systematics read the FGD and truth groups, so only fill them
+  // when an enabled configuration runs systematics or toys
+  bool systematics = false;
+  const std::vector<ConfigurationBase*>& configurations =
+    conf().GetConfigurations();
+  for(std::vector<ConfigurationBase*>::const_iterator it =
+    configurations.begin(); it != configurations.end(); ++it)
+  {
+    if((*it)->IsEnabled() && ((*it)->GetNToys() > 1 ||
+      !(*it)->GetEnabledSystematics().empty()))
+    {
+      systematics = true;
+    }
+  }
+  EventBoxTPCECal::SetFillSystematicsGroups(systematics);
 }
 
 void TPCECalSystematicsAnalysis::DefineMicroTrees(bool addBase)
@@ -92,6 +140,36 @@ void TPCECalSystematicsAnalysis::DefineMicroTrees(bool addBase)
       baseAnalysis::DefineMicroTrees(addBase);
    }
 
+   if(_runAllSelections)
+   {
+      // --- One entry per selection, in the order they were added -------
+      AddVarFixVI(output(), entersBarrel, "appears to enter the barrel ECal",
+         NTPCECALSELECTIONS);
+      AddVarFixVI(output(), entersDownstream,
+         "appears to enter the downstream ECal", NTPCECALSELECTIONS);
+      AddVarFixVI(output(), ecalDetector, "Number identifying the part of the "
+         "ECal that the track appears to enter. 9 == DS, 5 - 8 == BR",
+         NTPCECALSELECTIONS);
+      AddVarFixVI(output(), isMuonLike, "is muon candidate",
+         NTPCECALSELECTIONS);
+      AddVarFixVI(output(), isAntiMuonLike, "is antimuon candidate",
+         NTPCECALSELECTIONS);
+      AddVarFixVI(output(), isElectronLike, "is electron candidate",
+         NTPCECALSELECTIONS);
+      AddVarFixVI(output(), isPositronLike, "is positron candidate",
+         NTPCECALSELECTIONS);
+      AddVarFixVI(output(), isProtonLike, "is proton candidate",
+         NTPCECALSELECTIONS);
+      AddVarFixVF(output(), charge,
+         "Reconstructed charge of the selected track", NTPCECALSELECTIONS);
+      AddVarFixVF(output(), momentum,
+         "Reconstructed momentum of the selected track", NTPCECALSELECTIONS);
+      AddVarFixMF(output(), direction, "End direction of the selected track",
+         NTPCECALSELECTIONS, 3);
+
+      return;
+   }
+
    // --- Single variables -------
    AddVarI(output(), entersBarrel, "appears to enter the barrel ECal");
    AddVarI(output(), entersDownstream, "appears to enter the downstream ECal");
@@ -127,14 +205,46 @@ void TPCECalSystematicsAnalysis::FillMicroTrees(bool addBase)
       baseAnalysis::FillMicroTreesBase(addBase);
    }
 
-   const ToyBoxTPCECal* tpcECalBox = static_cast<const ToyBoxTPCECal*>(&box());
+   // The scan counts each event once, from the nominal toy
+   const bool scan = ThresholdScan::Get().IsEnabled() &&
+      (conf().GetCurrentConfigurationIndex() ==
+      ConfigurationManager::default_conf);
 
+   if(_runAllSelections)
+   {
+      for(unsigned int isel = 0; isel < NTPCECALSELECTIONS; ++isel)
+      {
+         const ToyBoxTPCECal& tpcECalBox =
+            static_cast<const ToyBoxTPCECal&>(box(isel));
+         FillSelectionVars(tpcECalBox, isel);
+         if(scan)
+         {
+            ThresholdScan::Get().Fill(tpcECalBox, SELECTIONPREFIXES[isel]);
+         }
+      }
+   }
+   else
+   {
+      const ToyBoxTPCECal& tpcECalBox =
+         static_cast<const ToyBoxTPCECal&>(box());
+      FillSelectionVars(tpcECalBox, -1);
+      if(scan)
+      {
+         ThresholdScan::Get().Fill(tpcECalBox, "");
+      }
+   }
+}
+
+void TPCECalSystematicsAnalysis::FillSelectionVars(
+   const ToyBoxTPCECal& tpcECalBox, const int isel)
+{
    // Muon candidate variables
-   AnaTrackB* track = tpcECalBox->selectedTrack;
+   AnaTrackB* track = tpcECalBox.selectedTrack;
    if (track)
    {
-      output().FillVar(entersBarrel, tpcECalBox->entersBarrel ? 1 : 0);
-      output().FillVar(entersDownstream, tpcECalBox->entersDownstream ? 1 : 0);
+      FillSelectionVar(entersBarrel, tpcECalBox.entersBarrel ? 1 : 0, isel);
+      FillSelectionVar(entersDownstream, tpcECalBox.entersDownstream ? 1 : 0,
+         isel);
 
       int det = SubDetId::kInvalid;
       if(IsDSECal(track->Detector))
@@ -146,28 +256,71 @@ void TPCECalSystematicsAnalysis::FillMicroTrees(bool addBase)
          det = SubDetId::kTECAL;
       }
 
-      output().FillVar(ecalDetector, det);
-      output().FillVar(isMuonLike, tpcECalBox->isMuonLike);
-      output().FillVar(isAntiMuonLike, tpcECalBox->isAntiMuonLike);
-      output().FillVar(isElectronLike, tpcECalBox->isElectronLike);
-      output().FillVar(isPositronLike, tpcECalBox->isPositronLike);
-      output().FillVar(isProtonLike, tpcECalBox->isProtonLike);
+      FillSelectionVar(ecalDetector, det, isel);
+      FillSelectionVar(isMuonLike, tpcECalBox.isMuonLike, isel);
+      FillSelectionVar(isAntiMuonLike, tpcECalBox.isAntiMuonLike, isel);
+      FillSelectionVar(isElectronLike, tpcECalBox.isElectronLike, isel);
+      FillSelectionVar(isPositronLike, tpcECalBox.isPositronLike, isel);
+      FillSelectionVar(isProtonLike, tpcECalBox.isProtonLike, isel);
 
+      // The segment is read directly, rather than from the varied columns
+      // of the segment cache, which hold the values of whichever toy
+      // refreshed them last
       AnaTpcTrack* backTpc = static_cast<AnaTpcTrack*>(
          anaUtils::GetTPCBackSegment(track));
-
-      output().FillVar(charge, backTpc->Charge);
-      output().FillVar(momentum, backTpc->Momentum);
-      output().FillVectorVarFromArray(direction, backTpc->DirectionEnd, 3);
+      if(backTpc)
+      {
+         FillSelectionVar(charge, backTpc->Charge, isel);
+         FillSelectionVar(momentum, backTpc->Momentum, isel);
+         if(isel < 0)
+         {
+            output().FillVectorVarFromArray(direction, backTpc->DirectionEnd,
+               3);
+         }
+         else
+         {
+            output().FillMatrixVarFromArray(direction, backTpc->DirectionEnd,
+               isel, 3);
+         }
+      }
    }   
 }
 
+void TPCECalSystematicsAnalysis::FillSelectionVar(const Int_t index,
+   const Int_t value, const int isel)
+{
+   if(isel < 0)
+   {
+      output().FillVar(index, value);
+   }
+   else
+   {
+      output().FillVectorVar(index, value, isel);
+   }
+}
+
+void TPCECalSystematicsAnalysis::FillSelectionVar(const Int_t index,
+   const Float_t value, const int isel)
+{
+   if(isel < 0)
+   {
+      output().FillVar(index, value);
+   }
+   else
+   {
+      output().FillVectorVar(index, value, isel);
+   }
+}
+
 void TPCECalSystematicsAnalysis::FillToyVarsInMicroTrees(bool addBase){
   // Fill the common variables
   if (addBase) baseAnalysis::FillToyVarsInMicroTreesBase(addBase);
 }
 
 bool TPCECalSystematicsAnalysis::CheckFillTruthTree(const AnaTrueVertex& vtx){
+  // A skim would only give the vertices of the spills it kept
+  if(_skimmedInput) return false;
+
   // In this case we only save numu (NuPDG=14) charged current  (0<ReacCode<30) interactions in the FGD1 FV
   bool numuCC=vtx.ReacCode>0 && vtx.ReacCode<30 && vtx.NuPDG==14;// && vtx.LeptonPDG==13;  
   return (anaUtils::InFiducialVolume(SubDetId::kFGD1, vtx.Position, FVDef::FVdefminFGD1,FVDef::FVdefmaxFGD1) && numuCC);
@@ -184,6 +337,19 @@ void TPCECalSystematicsAnalysis::FillTruthTree(const AnaTrueVertex& vtx){
 
 void TPCECalSystematicsAnalysis::FillCategories()
 {
+   if(_runAllSelections)
+   {
+      for(unsigned int isel = 0; isel < NTPCECALSELECTIONS; ++isel)
+      {
+         const ToyBoxTPCECal* tpcECalBox =
+            static_cast<const ToyBoxTPCECal*>(&box(isel));
+         anaUtils::FillCategories(_event, static_cast<AnaTrack*>(
+            tpcECalBox->selectedTrack), SELECTIONPREFIXES[isel],
+            SubDetId::kFGD1);
+      }
+      return;
+   }
+
    const ToyBoxTPCECal* tpcECalBox = static_cast<const ToyBoxTPCECal*>(&box());
    anaUtils::FillCategories(_event, static_cast<AnaTrack*>(
       tpcECalBox->selectedTrack), "", SubDetId::kFGD1);
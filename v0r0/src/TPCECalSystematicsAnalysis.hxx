@@ -4,6 +4,11 @@
 #include "baseAnalysis.hxx"
 #include "AnalysisUtils.hxx"
 
+class ToyBoxTPCECal;
+
+/// Number of TPC/ECal selections, in the order they are added
+const unsigned int NTPCECALSELECTIONS = 5;
+
 class TPCECalSystematicsAnalysis: public baseAnalysis {
  public:
   TPCECalSystematicsAnalysis(AnalysisAlgorithm* ana=NULL);
@@ -54,7 +59,6 @@ public:
       enumStandardMicroTreesLast_TPCECalSystematicsAnalysis
    };
 
-private:
    /**
       Extracts the bits that identify parts of the barrel ECal and checks if
       they are set.
@@ -64,7 +68,7 @@ private:
       \return  True if the track intersects part of the barrel ECal, False
                otherwise.
    */
-   bool IsBarrelECal(const unsigned long detector);
+   static bool IsBarrelECal(const unsigned long detector);
 
    /**
       Extracts the bit that identifies the DS ECal and checks if it is set.
@@ -73,7 +77,48 @@ private:
                         AnaTrackB::Detector.
       \return  True if the track intersects the DS ECal, False otherwise.
    */
-   bool IsDSECal(const unsigned long detector);
+   static bool IsDSECal(const unsigned long detector);
+
+   /**
+      Sets whether the input is a skim made by RunTPCECalSkim. A skim only
+      holds the spills that can pass the preselection, so it lacks the signal
+      vertices of every other spill, and no truth tree is written for it.
+
+      \param skimmed Whether the input is a skim.
+   */
+   static void SetSkimmedInput(const bool skimmed)
+   {
+      _skimmedInput = skimmed;
+   }
+
+private:
+   /**
+      Fills the selected track variables of one selection.
+
+      \param tpcECalBox The box of the selection.
+      \param isel The index of the selection, or -1 if the variables are
+                  scalars because only one selection is being run.
+   */
+   void FillSelectionVars(const ToyBoxTPCECal& tpcECalBox, const int isel);
+
+   /**
+      Fills a single variable or, when every selection is being run, the
+      element of a vector variable that belongs to a selection.
+
+      \param index   The variable to fill.
+      \param value   The value.
+      \param isel The index of the selection, or -1 for a single variable.
+   */
+   void FillSelectionVar(const Int_t index, const Int_t value, const int isel);
+   void FillSelectionVar(const Int_t index, const Float_t value,
+      const int isel);
+
+   /// Whether every selection is run in a single pass, with per-selection
+   /// vector variables and categories
+   bool _runAllSelections;
+
+   /// Whether the input is a skim, see SetSkimmedInput
+   static bool _skimmedInput;
 };
 
 #endif
@@ -0,0 +1,259 @@
+#include <iostream>
+#include "ThresholdScan.hxx"
+#include "TPCECalSystematicsAnalysis.hxx"
+#include "Parameters.hxx"
+#include "TFile.h"
+#include "TH3D.h"
+
+/// Working arrays of Fill and FindHighestMomentum
+static ScratchBuffer<int> scratchRows;
+static ScratchBuffer<unsigned char> scratchRegions;
+
+ThresholdScan& ThresholdScan::Get()
+{
+   static ThresholdScan scan;
+   return scan;
+}
+
+ThresholdScan::ThresholdScan(): _enabled(false)
+{
+}
+
+bool ThresholdScan::Configure()
+{
+   _enabled = ND::params().GetParameterI(
+      "TPCECalSystematicsAnalysis.Scan.ScanThresholds");
+   if(!_enabled)
+   {
+      return true;
+   }
+
+   // The kernel needs the cosine of each limit to have a fixed sign
+   if(!ReadAxis("DSAngleMax", 0, 90, _dsAngleMax) ||
+      !ReadAxis("BarrelAngleMin", 0, 90, _barrelAngleMin) ||
+      !ReadAxis("BarrelAzimuthAbs", 90, 180, _barrelAzimuthAbs))
+   {
+      return false;
+   }
+
+   _dsKernels.clear();
+   for(unsigned int i = 0; i < _dsAngleMax.size(); ++i)
+   {
+      _dsKernels.push_back(ECalAcceptanceKernel(_dsAngleMax[i],
+         Barrel::TpcAngleMin, Barrel::TpcAzimuthAbs));
+   }
+
+   _barrelKernels.clear();
+   for(unsigned int k = 0; k < _barrelAzimuthAbs.size(); ++k)
+   {
+      for(unsigned int j = 0; j < _barrelAngleMin.size(); ++j)
+      {
+         _barrelKernels.push_back(ECalAcceptanceKernel(DS::TpcAngleMax,
+            _barrelAngleMin[j], _barrelAzimuthAbs[k]));
+      }
+   }
+
+   return true;
+}
+
+bool ThresholdScan::ReadAxis(const std::string& name, const double low,
+   const double high, std::vector<double>& values)
+{
+   const std::string prefix = "TPCECalSystematicsAnalysis.Scan." + name + ".";
+   const int points = ND::params().GetParameterI(prefix + "Points");
+   const double first = ND::params().GetParameterD(prefix + "First");
+   const double last = ND::params().GetParameterD(prefix + "Last");
+
+   if(points < 1 || first < low || last > high ||
+      (points > 1 && last <= first))
+   {
+      std::cerr << "ThresholdScan: " << name << " needs at least one point, "
+         "from First to Last, within " << low << " - " << high << std::endl;
+      return false;
+   }
+
+   values.clear();
+   for(int i = 0; i < points; ++i)
+   {
+      values.push_back(points > 1 ? first + i * (last - first) / (points - 1) :
+         first);
+   }
+
+   return true;
+}
+
+AnaTrackB* ThresholdScan::FindHighestMomentum(
+   const TPCBackSegmentCache& segments, const int* rows, const unsigned int n,
+   const ECalAcceptanceKernel& kernel, const unsigned char region)
+{
+   unsigned char* regions = scratchRegions.Get(n);
+   kernel.Classify(segments, rows, n, regions);
+
+   // As FindECalTracksAction, the first of equal momentum tracks is kept
+   AnaTrackB* track = nullptr;
+   Float_t highestMomentum = 0;
+   for(unsigned int j = 0; j < n; ++j)
+   {
+      const Float_t momentum = segments.TrackMomentum[rows[j]];
+      if((regions[j] & region) && momentum > highestMomentum)
+      {
+         highestMomentum = momentum;
+         track = segments.Track[rows[j]];
+      }
+   }
+
+   return track;
+}
+
+void ThresholdScan::Fill(const ToyBoxTPCECal& tpcECalBox,
+   const std::string& prefix)
+{
+   // Each selection only sets its own flag, which it tests in its last cut
+   // before the ECal track is found
+   if(!(tpcECalBox.isElectronLike || tpcECalBox.isPositronLike ||
+      tpcECalBox.isMuonLike || tpcECalBox.isAntiMuonLike ||
+      tpcECalBox.isProtonLike))
+   {
+      return;
+   }
+
+   // The negative candidates are searched before the positive ones, in one
+   // batch
+   const TPCBackSegmentCache& segments = *tpcECalBox.segments;
+   const TrackCandidateSet* sets[2] = {&tpcECalBox.negativeTracks,
+      &tpcECalBox.positiveTracks};
+   int* rows = scratchRows.Get(sets[0]->GetNumEntries() +
+      sets[1]->GetNumEntries());
+   unsigned int n = 0;
+   for(unsigned int s = 0; s < 2; ++s)
+   {
+      for(unsigned int i = 0; i < sets[s]->GetNumEntries(); ++i)
+      {
+         if(sets[s]->IsSelected(i))
+         {
+            rows[n++] = sets[s]->GetIndex(i);
+         }
+      }
+   }
+
+   std::vector<AnaTrackB*> dsTracks(_dsKernels.size());
+   for(unsigned int i = 0; i < _dsKernels.size(); ++i)
+   {
+      dsTracks[i] = FindHighestMomentum(segments, rows, n, _dsKernels[i],
+         ECalAcceptanceKernel::kDownstream);
+   }
+
+   std::vector<AnaTrackB*> barrelTracks(_barrelKernels.size());
+   for(unsigned int jk = 0; jk < _barrelKernels.size(); ++jk)
+   {
+      barrelTracks[jk] = FindHighestMomentum(segments, rows, n,
+         _barrelKernels[jk], ECalAcceptanceKernel::kBarrel);
+   }
+
+   const unsigned int nPoints = _dsKernels.size() * _barrelKernels.size();
+   Counts& downstream = _downstream[prefix];
+   Counts& barrel = _barrel[prefix];
+   if(downstream.Selected.empty())
+   {
+      downstream.Selected.resize(nPoints, 0);
+      downstream.Matched.resize(nPoints, 0);
+      barrel.Selected.resize(nPoints, 0);
+      barrel.Matched.resize(nPoints, 0);
+   }
+
+   // As FindECalTracksAction, the barrel takes priority
+   for(unsigned int jk = 0; jk < _barrelKernels.size(); ++jk)
+   {
+      for(unsigned int i = 0; i < _dsKernels.size(); ++i)
+      {
+         const unsigned int point = jk * _dsKernels.size() + i;
+         if(barrelTracks[jk])
+         {
+            ++barrel.Selected[point];
+            if(TPCECalSystematicsAnalysis::IsBarrelECal(
+               barrelTracks[jk]->Detector))
+            {
+               ++barrel.Matched[point];
+            }
+         }
+         else if(dsTracks[i])
+         {
+            ++downstream.Selected[point];
+            if(TPCECalSystematicsAnalysis::IsDSECal(dsTracks[i]->Detector))
+            {
+               ++downstream.Matched[point];
+            }
+         }
+      }
+   }
+}
+
+/**
+   Finds the bin edges of an axis of the scan, with the low edge of each bin at
+   one of the limits.
+
+   \param values  The limits.
+   \return  The bin edges.
+*/
+static std::vector<double> GetBinEdges(const std::vector<double>& values)
+{
+   std::vector<double> edges(values);
+   edges.push_back(values.size() > 1 ?
+      2 * values.back() - values[values.size() - 2] : values.back() + 1);
+
+   return edges;
+}
+
+void ThresholdScan::Write(const std::string& filename) const
+{
+   TFile file(filename.c_str(), "UPDATE");
+   if(file.IsZombie())
+   {
+      std::cerr << "ThresholdScan: could not open " << filename << std::endl;
+      return;
+   }
+
+   const std::vector<double> xEdges = GetBinEdges(_dsAngleMax);
+   const std::vector<double> yEdges = GetBinEdges(_barrelAngleMin);
+   const std::vector<double> zEdges = GetBinEdges(_barrelAzimuthAbs);
+
+   const std::map<std::string, Counts>* regions[2] = {&_downstream, &_barrel};
+   const char* regionNames[2] = {"ds", "barrel"};
+   for(unsigned int r = 0; r < 2; ++r)
+   {
+      std::map<std::string, Counts>::const_iterator it;
+      for(it = regions[r]->begin(); it != regions[r]->end(); ++it)
+      {
+         const std::string name = it->first + "scan_" + regionNames[r];
+         const std::vector<double>* counts[2] = {&it->second.Selected,
+            &it->second.Matched};
+         const char* countNames[2] = {"_selected", "_matched"};
+         for(unsigned int c = 0; c < 2; ++c)
+         {
+            TH3D histogram((name + countNames[c]).c_str(),
+               ";DS TpcAngleMax;Barrel TpcAngleMin;Barrel TpcAzimuthAbs",
+               xEdges.size() - 1, &xEdges[0], yEdges.size() - 1, &yEdges[0],
+               zEdges.size() - 1, &zEdges[0]);
+
+            // The points are ordered by DS limit, then barrel polar limit,
+            // then barrel azimuthal limit
+            unsigned int point = 0;
+            for(unsigned int k = 0; k < _barrelAzimuthAbs.size(); ++k)
+            {
+               for(unsigned int j = 0; j < _barrelAngleMin.size(); ++j)
+               {
+                  for(unsigned int i = 0; i < _dsAngleMax.size(); ++i)
+                  {
+                     histogram.SetBinContent(i + 1, j + 1, k + 1,
+                        (*counts[c])[point++]);
+                  }
+               }
+            }
+            histogram.SetEntries(histogram.GetSumOfWeights());
+            histogram.Write();
+         }
+      }
+   }
+
+   file.Close();
+}
@@ -0,0 +1,135 @@
+#ifndef ThresholdScan_h
+#define ThresholdScan_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include "TPCECalSelection.hxx"
+
+/**
+   Counts the events that each selection would select, and how many of those
+   are matched to the ECal, on a grid of the angular limits of the ECal
+   acceptance, in a single pass over the data.
+
+   The grid spans the DS TpcAngleMax, the barrel TpcAngleMin and the barrel
+   TpcAzimuthAbs, each read from the Scan section of the parameters file. For
+   every event that passes the cuts before the ECal track is found, the
+   candidates are classified with the acceptance kernel of every grid point and
+   the track FindECalTracksAction would select there is found. An event is
+   selected by the DS or the barrel branch as at the nominal limits, and is
+   matched if its selected track has a segment in that ECal.
+
+   The DS limit only affects the DS region and the barrel limits only the
+   barrel region, so each event needs a classification per DS limit and per
+   pair of barrel limits rather than per grid point.
+   Only the angular limits are scanned. The PID pull windows are applied by
+   the PID action of each selection, before the candidates reach the ECal
+   step, and for the muon, antimuon and proton together with a cutUtils PID
+   cut on the global track. A window grid would need the candidates from
+   before the PID action and that cut per grid point. To retune the windows,
+   rerun the analysis from a step checkpoint (see StepCheckpoint), which
+   replays every step before the PID action.
+*/
+class ThresholdScan
+{
+public:
+   /**
+      Retrieves the scan shared by all selections.
+
+      \return  The scan.
+   */
+   static ThresholdScan& Get();
+
+   virtual ~ThresholdScan(){ }
+
+   /**
+      Reads whether to scan, and the grid, from the parameters file.
+
+      \return  True if the scan is disabled or its grid is valid, False
+               otherwise.
+   */
+   bool Configure();
+
+   /**
+      Checks whether the scan is enabled.
+
+      \return  True if events are being scanned, False otherwise.
+   */
+   bool IsEnabled() const { return _enabled; }
+
+   /**
+      Adds the nominal toy of an event to the counts of a selection.
+
+      \param tpcECalBox The box of the selection.
+      \param prefix  The category prefix of the selection, which names its
+                     counts.
+   */
+   void Fill(const ToyBoxTPCECal& tpcECalBox, const std::string& prefix);
+
+   /**
+      Writes the counts as histograms of a ROOT file. For each selection and
+      ECal region there is a <prefix>scan_<region>_selected and a
+      <prefix>scan_<region>_matched TH3D, whose x, y and z axes are the DS
+      TpcAngleMax, the barrel TpcAngleMin and the barrel TpcAzimuthAbs. The
+      low edge of each bin is the limit it was counted at, so the histograms
+      of parallel jobs can be added.
+
+      \param filename   The file to update, normally the output file of the
+                        analysis.
+   */
+   void Write(const std::string& filename) const;
+
+private:
+   ThresholdScan();
+
+   /// The selected and matched counts of one region, by grid point
+   struct Counts
+   {
+      std::vector<double> Selected;
+      std::vector<double> Matched;
+   };
+
+   /**
+      Reads the limits of one axis of the grid.
+
+      \param name The name of the limit in the parameters file.
+      \param low  The smallest limit allowed.
+      \param high The largest limit allowed.
+      \param values  Set to the limits, in increasing order.
+      \return  True if the limits are valid, False otherwise.
+   */
+   static bool ReadAxis(const std::string& name, const double low,
+      const double high, std::vector<double>& values);
+
+   /**
+      Finds the highest momentum track of the candidates in a region.
+
+      \param segments   The segment cache of the event.
+      \param rows    The rows of the candidates.
+      \param n       The number of candidates.
+      \param kernel  The kernel to classify them with.
+      \param region  The ECalAcceptanceKernel::RegionEnum flag of the region.
+      \return  The track, or null if none is in the region.
+   */
+   static AnaTrackB* FindHighestMomentum(const TPCBackSegmentCache& segments,
+      const int* rows, const unsigned int n,
+      const ECalAcceptanceKernel& kernel, const unsigned char region);
+
+   /// Whether to scan
+   bool _enabled;
+   /// The DS TpcAngleMax limits
+   std::vector<double> _dsAngleMax;
+   /// The barrel TpcAngleMin limits
+   std::vector<double> _barrelAngleMin;
+   /// The barrel TpcAzimuthAbs limits
+   std::vector<double> _barrelAzimuthAbs;
+   /// A kernel per DS limit, at the nominal barrel limits
+   std::vector<ECalAcceptanceKernel> _dsKernels;
+   /// A kernel per pair of barrel limits, at the nominal DS limit
+   std::vector<ECalAcceptanceKernel> _barrelKernels;
+   /// Counts of the DS and barrel regions of each selection, by prefix
+   std::map<std::string, Counts> _downstream;
+   std::map<std::string, Counts> _barrel;
+};
+
+#endif